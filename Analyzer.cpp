@@ -0,0 +1,425 @@
+#include "Analyzer.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+using Memory = std::array<uint8_t, CHIP8::memorySize>;
+
+static uint16_t Word(const Memory& memory, uint32_t address)
+{
+    return static_cast<uint16_t>((memory[address % CHIP8::memorySize] << 8) | memory[(address + 1) % CHIP8::memorySize]);
+}
+
+static bool IsSkip(OpKind kind)
+{
+    switch (kind)
+    {
+        case OpKind::SE_3xnn:
+        case OpKind::SNE_4xnn:
+        case OpKind::SE_5xy0:
+        case OpKind::SNE_9xy0:
+        case OpKind::SKP_Ex9E:
+        case OpKind::SKNP_ExA1:
+            return true;
+        default:
+            return false;
+    }
+}
+
+//F000 nnnn is the only four-byte instruction
+static uint32_t Length(OpKind kind)
+{
+    return kind == OpKind::LD_F000 ? 4 : 2;
+}
+
+//Where a taken skip at address lands - past the whole of an F000 nnnn
+static uint32_t SkipTarget(const Memory& memory, uint32_t next)
+{
+    return next + (Word(memory, next) == 0xF000 ? 4 : 2);
+}
+
+//Every address execution can go on to from the instruction at address, plus whether it ends its basic block
+static bool Successors(const Memory& memory, uint32_t address, const DecodedOp& op, std::vector<uint32_t>& successors)
+{
+    const uint32_t next = address + Length(op.kind);
+    switch (op.kind)
+    {
+        case OpKind::JP_1nnn:
+            successors.push_back(op.nnn);
+            return true;
+        case OpKind::CALL_2nnn:
+            successors.push_back(op.nnn);
+            successors.push_back(next);
+            return true;
+        case OpKind::RET:
+        case OpKind::EXIT_00FD:
+        case OpKind::JP_Bnnn:
+        case OpKind::Invalid:
+            return true;
+        default:
+            break;
+    }
+
+    successors.push_back(next);
+    if (IsSkip(op.kind))
+    {
+        successors.push_back(SkipTarget(memory, next));
+        return true;
+    }
+
+    return false;
+}
+
+size_t ProgramAnalysis::Instructions() const
+{
+    return std::count(bytes.begin(), bytes.end(), Byte::Opcode);
+}
+
+ProgramAnalysis AnalyzeProgram(const Memory& memory, uint16_t entry)
+{
+    ProgramAnalysis analysis;
+    analysis.bytes.assign(CHIP8::memorySize, ProgramAnalysis::Byte::Data);
+
+    for (size_t address = CHIP8::memorySize; address > 0x200; address--)
+    {
+        if (memory[address - 1] != 0)
+        {
+            analysis.imageEnd = static_cast<uint16_t>(address);
+            break;
+        }
+    }
+
+    //Pass 1 - mark every reachable instruction and collect the block leaders: the entry, every branch target and
+    //the instruction after every branch
+    std::set<uint16_t> leaders = { entry };
+    std::set<uint16_t> subroutines;
+    std::set<uint16_t> invalid;
+    std::vector<uint32_t> work = { entry };
+    std::vector<uint32_t> successors;
+    while (!work.empty())
+    {
+        uint32_t address = work.back();
+        work.pop_back();
+
+        //Straight-line walk until a branch, or code that was already walked
+        while (address + 1 < CHIP8::memorySize && analysis.bytes[address] == ProgramAnalysis::Byte::Data)
+        {
+            const DecodedOp op = CHIP8::Decode(Word(memory, address));
+            if (op.kind == OpKind::Invalid)
+            {
+                invalid.insert(static_cast<uint16_t>(address));
+                break;
+            }
+            if (address + Length(op.kind) > CHIP8::memorySize)
+            {
+                break;
+            }
+
+            analysis.bytes[address] = ProgramAnalysis::Byte::Opcode;
+            for (uint32_t i = 1; i < Length(op.kind); i++)
+            {
+                if (analysis.bytes[address + i] == ProgramAnalysis::Byte::Data)
+                {
+                    analysis.bytes[address + i] = ProgramAnalysis::Byte::Operand;
+                }
+            }
+            if (op.kind == OpKind::JP_Bnnn)
+            {
+                analysis.indirectJumps.push_back(static_cast<uint16_t>(address));
+            }
+            if (op.kind == OpKind::CALL_2nnn)
+            {
+                subroutines.insert(op.nnn);
+            }
+
+            successors.clear();
+            if (!Successors(memory, address, op, successors))
+            {
+                address = successors[0];
+                continue;
+            }
+
+            for (uint32_t successor : successors)
+            {
+                if (successor + 1 < CHIP8::memorySize)
+                {
+                    leaders.insert(static_cast<uint16_t>(successor));
+                    work.push_back(successor);
+                }
+            }
+            break;
+        }
+    }
+
+    //Pass 2 - cut the marked code into basic blocks at the leaders
+    for (uint16_t leader : leaders)
+    {
+        if (analysis.bytes[leader] != ProgramAnalysis::Byte::Opcode)
+        {
+            continue;
+        }
+
+        BasicBlock block;
+        block.start = leader;
+        uint32_t address = leader;
+        while (true)
+        {
+            const DecodedOp op = CHIP8::Decode(Word(memory, address));
+            successors.clear();
+            bool ends = Successors(memory, address, op, successors);
+            address += Length(op.kind);
+
+            if (ends || address >= CHIP8::memorySize || analysis.bytes[address] != ProgramAnalysis::Byte::Opcode ||
+                leaders.count(static_cast<uint16_t>(address)))
+            {
+                block.indirect = op.kind == OpKind::JP_Bnnn;
+                for (uint32_t successor : successors)
+                {
+                    //Falling off the end of memory or into something that does not decode goes nowhere
+                    if (successor + 1 < CHIP8::memorySize && analysis.bytes[successor] == ProgramAnalysis::Byte::Opcode)
+                    {
+                        block.successors.push_back(static_cast<uint16_t>(successor));
+                    }
+                }
+                break;
+            }
+        }
+
+        block.end = static_cast<uint16_t>(std::min<uint32_t>(address, CHIP8::memorySize - 1));
+        analysis.blocks[leader] = block;
+    }
+
+    analysis.subroutines.assign(subroutines.begin(), subroutines.end());
+    analysis.invalid.assign(invalid.begin(), invalid.end());
+    return analysis;
+}
+
+std::shared_ptr<const ProgramAnalysis> AnalyzeCached(const Memory& memory)
+{
+    static std::mutex mutex;
+    static std::unordered_map<uint64_t, std::shared_ptr<const ProgramAnalysis>> cache;
+
+    //64-bit FNV-1a of the image, like RomImage::Hash
+    uint64_t hash = 14695981039346656037ull;
+    for (uint8_t byte : memory)
+    {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = cache.find(hash);
+        if (found != cache.end())
+        {
+            return found->second;
+        }
+    }
+
+    //Analyzed outside the lock - two threads racing on a new program both analyze it and the first result is kept
+    auto analysis = std::make_shared<const ProgramAnalysis>(AnalyzeProgram(memory));
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.emplace(hash, analysis).first->second;
+}
+
+static std::string Register(uint8_t x)
+{
+    return std::string("V") + "0123456789ABCDEF"[x & 0xF];
+}
+
+static std::string Hex(uint32_t value, int digits)
+{
+    std::ostringstream out;
+    out << "0x" << std::uppercase << std::hex << std::setw(digits) << std::setfill('0') << value;
+    return out.str();
+}
+
+std::string Disassemble(uint16_t opcode, uint16_t next)
+{
+    const DecodedOp op = CHIP8::Decode(opcode);
+    const std::string vx = Register(op.x);
+    const std::string vy = Register(op.y);
+    const std::string nn = Hex(op.nn, 2);
+    const std::string nnn = Hex(op.nnn, 3);
+    const std::string n = std::to_string(op.n);
+
+    switch (op.kind)
+    {
+        case OpKind::CLS: return "CLS";
+        case OpKind::RET: return "RET";
+        case OpKind::JP_1nnn: return "JP " + nnn;
+        case OpKind::CALL_2nnn: return "CALL " + nnn;
+        case OpKind::SE_3xnn: return "SE " + vx + ", " + nn;
+        case OpKind::SNE_4xnn: return "SNE " + vx + ", " + nn;
+        case OpKind::SE_5xy0: return "SE " + vx + ", " + vy;
+        case OpKind::LD_6xnn: return "LD " + vx + ", " + nn;
+        case OpKind::ADD_7xnn: return "ADD " + vx + ", " + nn;
+        case OpKind::LD_8xy0: return "LD " + vx + ", " + vy;
+        case OpKind::OR_8xy1: return "OR " + vx + ", " + vy;
+        case OpKind::AND_8xy2: return "AND " + vx + ", " + vy;
+        case OpKind::XOR_8xy3: return "XOR " + vx + ", " + vy;
+        case OpKind::ADD_8xy4: return "ADD " + vx + ", " + vy;
+        case OpKind::SUB_8xy5: return "SUB " + vx + ", " + vy;
+        case OpKind::SHR_8xy6: return "SHR " + vx + ", " + vy;
+        case OpKind::SUBN_8xy7: return "SUBN " + vx + ", " + vy;
+        case OpKind::SHL_8xyE: return "SHL " + vx + ", " + vy;
+        case OpKind::SNE_9xy0: return "SNE " + vx + ", " + vy;
+        case OpKind::LD_Annn: return "LD I, " + nnn;
+        case OpKind::JP_Bnnn: return "JP V0, " + nnn;
+        case OpKind::RND_Cxnn: return "RND " + vx + ", " + nn;
+        case OpKind::DRW_Dxyn: return "DRW " + vx + ", " + vy + ", " + n;
+        case OpKind::SKP_Ex9E: return "SKP " + vx;
+        case OpKind::SKNP_ExA1: return "SKNP " + vx;
+        case OpKind::LD_Fx07: return "LD " + vx + ", DT";
+        case OpKind::LD_Fx0A: return "LD " + vx + ", K";
+        case OpKind::LD_Fx15: return "LD DT, " + vx;
+        case OpKind::LD_Fx18: return "LD ST, " + vx;
+        case OpKind::ADD_Fx1E: return "ADD I, " + vx;
+        case OpKind::LD_Fx29: return "LD F, " + vx;
+        case OpKind::LD_Fx33: return "LD B, " + vx;
+        case OpKind::LD_Fx55: return "LD [I], " + vx;
+        case OpKind::LD_Fx65: return "LD " + vx + ", [I]";
+        case OpKind::SCD_00Cn: return "SCD " + n;
+        case OpKind::SCU_00Dn: return "SCU " + n;
+        case OpKind::SCR_00FB: return "SCR";
+        case OpKind::SCL_00FC: return "SCL";
+        case OpKind::EXIT_00FD: return "EXIT";
+        case OpKind::LOW_00FE: return "LOW";
+        case OpKind::HIGH_00FF: return "HIGH";
+        case OpKind::LD_5xy2: return "SAVE " + vx + "-" + vy;
+        case OpKind::LD_5xy3: return "LOAD " + vx + "-" + vy;
+        case OpKind::LD_F000: return "LD I, " + Hex(next, 4);
+        case OpKind::PLANE_Fn01: return "PLANE " + std::to_string(op.x);
+        case OpKind::AUDIO_F002: return "AUDIO";
+        case OpKind::LD_Fx30: return "LD HF, " + vx;
+        case OpKind::PITCH_Fx3A: return "PITCH " + vx;
+        case OpKind::LD_Fx75: return "LD R, " + vx;
+        case OpKind::LD_Fx85: return "LD " + vx + ", R";
+        case OpKind::Invalid: break;
+        //Superinstructions only exist inside the block cache
+        default: break;
+    }
+
+    return "DW " + Hex(opcode, 4);
+}
+
+static std::string Address(uint32_t address)
+{
+    return Hex(address, 3);
+}
+
+void WriteListing(const ProgramAnalysis& analysis, const Memory& memory, std::ostream& out)
+{
+    using Byte = ProgramAnalysis::Byte;
+
+    size_t dataBytes = 0;
+    for (uint32_t address = 0x200; address < analysis.imageEnd; address++)
+    {
+        dataBytes += analysis.bytes[address] == Byte::Data;
+    }
+
+    out << "; " << analysis.Instructions() << " instructions in " << analysis.blocks.size() << " blocks, "
+        << analysis.subroutines.size() << " subroutines, " << dataBytes << " data bytes up to " << Address(analysis.imageEnd)
+        << ", " << analysis.indirectJumps.size() << " indirect jumps, " << analysis.invalid.size() << " invalid targets\n";
+
+    //Code anywhere in memory, data only within the program image
+    uint32_t address = 0;
+    while (address < CHIP8::memorySize)
+    {
+        auto block = analysis.blocks.find(static_cast<uint16_t>(address));
+        if (block != analysis.blocks.end())
+        {
+            out << '\n';
+            if (std::binary_search(analysis.subroutines.begin(), analysis.subroutines.end(), address))
+            {
+                out << "; subroutine " << Address(address) << '\n';
+            }
+            out << "; block " << Address(block->second.start) << '-' << Address(block->second.end) << " ->";
+            for (uint16_t successor : block->second.successors)
+            {
+                out << ' ' << Address(successor);
+            }
+            out << (block->second.indirect ? " (indirect)" : "") << '\n';
+        }
+
+        if (analysis.bytes[address] == Byte::Opcode)
+        {
+            const uint16_t opcode = Word(memory, address);
+            const uint16_t next = Word(memory, address + 2);
+            const bool wide = CHIP8::Decode(opcode).kind == OpKind::LD_F000;
+            out << Address(address) << "  " << std::uppercase << std::hex << std::setw(4) << std::setfill('0') << opcode;
+            out << (wide ? " " : "      ");
+            if (wide)
+            {
+                out << std::setw(4) << next << ' ';
+            }
+            out << std::dec << Disassemble(opcode, next) << '\n';
+            address += wide ? 4 : 2;
+            continue;
+        }
+
+        if (address < 0x200 || address >= analysis.imageEnd || analysis.bytes[address] != Byte::Data)
+        {
+            address++;
+            continue;
+        }
+
+        //Up to 8 data bytes a line, stopping at the next code
+        out << Address(address) << "  DB";
+        for (int i = 0; i < 8 && address < analysis.imageEnd && analysis.bytes[address] == Byte::Data; i++, address++)
+        {
+            out << ' ' << Hex(memory[address], 2);
+        }
+        out << '\n';
+    }
+}
+
+void WriteCFG(const ProgramAnalysis& analysis, std::ostream& out)
+{
+    out << "digraph cfg {\n    node [shape=box, fontname=monospace];\n";
+    for (const auto& [start, block] : analysis.blocks)
+    {
+        const bool subroutine = std::binary_search(analysis.subroutines.begin(), analysis.subroutines.end(), start);
+        out << "    \"" << Address(start) << "\" [label=\"" << Address(start) << '-' << Address(block.end) << "\""
+            << (subroutine ? ", style=bold" : "") << (block.indirect ? ", color=red" : "") << "];\n";
+        for (uint16_t successor : block.successors)
+        {
+            out << "    \"" << Address(start) << "\" -> \"" << Address(successor) << "\";\n";
+        }
+    }
+    out << "}\n";
+}
+
+int RunAnalysis(const Options& options)
+{
+    CHIP8 cpu(Core::Switch);
+    cpu.Init(options.romPath);
+    const ProgramAnalysis analysis = AnalyzeProgram(cpu.Memory());
+
+    bool ok = true;
+    if (!options.disassemblePath.empty())
+    {
+        std::ofstream file(options.disassemblePath);
+        WriteListing(analysis, cpu.Memory(), file);
+        if (!file)
+        {
+            std::cerr << "Failed to write disassembly to " << options.disassemblePath << '\n';
+            ok = false;
+        }
+    }
+    if (!options.cfgPath.empty())
+    {
+        std::ofstream file(options.cfgPath);
+        WriteCFG(analysis, file);
+        if (!file)
+        {
+            std::cerr << "Failed to write control-flow graph to " << options.cfgPath << '\n';
+            ok = false;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "CHIP8.h"
+#include "Options.h"
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//Static control-flow analysis of a program image - recursive descent from the entry point following 1nnn/2nnn,
+//skips and 00EE, so every byte it marks as code is reachable through direct control flow. Bnnn targets and
+//self-modified code cannot be seen statically; the blocks they reach are left as data (and found at run time as before).
+
+//One basic block - straight-line code from start up to end (one past its last byte)
+//successors are the addresses it can continue at: a jump's target, both ways out of a skip, or for a 2nnn the
+//subroutine and the return point. RET, 00FD, Bnnn and invalid opcodes have none.
+struct BasicBlock
+{
+    uint16_t start = 0;
+    uint16_t end = 0;
+    std::vector<uint16_t> successors;
+
+    //Ends in Bnnn, whose target depends on V0
+    bool indirect = false;
+};
+
+struct ProgramAnalysis
+{
+    enum class Byte : uint8_t
+    {
+        Data,
+        Opcode,
+        Operand
+    };
+
+    //What every address of the image holds - the first byte of an instruction, the rest of one, or anything else
+    std::vector<Byte> bytes;
+    std::map<uint16_t, BasicBlock> blocks;
+
+    //2nnn targets, Bnnn sites, and addresses control flow reached that do not decode
+    std::vector<uint16_t> subroutines;
+    std::vector<uint16_t> indirectJumps;
+    std::vector<uint16_t> invalid;
+
+    //One past the last non-zero byte from 0x200 on - where the program image ends
+    uint16_t imageEnd = 0x200;
+
+    size_t Instructions() const;
+};
+
+//Analyze a whole address space image, starting at entry
+ProgramAnalysis AnalyzeProgram(const std::array<uint8_t, CHIP8::memorySize>& memory, uint16_t entry = 0x200);
+
+//AnalyzeProgram through a process-wide cache keyed by a hash of the image, so each distinct program is only analyzed
+//once however many instances run it - safe to call from several threads
+std::shared_ptr<const ProgramAnalysis> AnalyzeCached(const std::array<uint8_t, CHIP8::memorySize>& memory);
+
+//Assembly text for one instruction (next is the word after it, for F000 nnnn)
+std::string Disassemble(uint16_t opcode, uint16_t next);
+
+//Listing of the image: a summary, then every instruction and data byte in address order, with each basic block's
+//successors and each subroutine marked above its first instruction
+void WriteListing(const ProgramAnalysis& analysis, const std::array<uint8_t, CHIP8::memorySize>& memory, std::ostream& out);
+
+//The control-flow graph as a Graphviz digraph - one node per basic block
+void WriteCFG(const ProgramAnalysis& analysis, std::ostream& out);
+
+//Load options.romPath and write options.disassemblePath and/or options.cfgPath - returns the process exit code
+int RunAnalysis(const Options& options);
@@ -0,0 +1,141 @@
+#include "Audio.h"
+#include <cmath>
+
+AudioState CurrentAudioState(const CHIP8& cpu)
+{
+    AudioState state;
+    state.on = cpu.SoundActive();
+    state.pitch = cpu.pitch;
+    state.pattern = cpu.audioPattern;
+    return state;
+}
+
+AudioQueue::AudioQueue(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+
+    events.resize(size);
+    mask = size - 1;
+}
+
+bool AudioQueue::Push(const AudioEvent& event)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) > mask)
+    {
+        return false;
+    }
+
+    events[h & mask] = event;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+bool AudioQueue::Pop(AudioEvent& event)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    event = events[t & mask];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+AudioSynth::AudioSynth(AudioQueue& queue, int sampleRate, int bufferSamples)
+    : queue(queue), sampleRate(sampleRate), latency(bufferSamples + sampleRate / 30)
+{
+}
+
+void AudioSynth::Render(int16_t* out, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        //Apply every event due by this sample
+        while (havePending || queue.Pop(pending))
+        {
+            havePending = true;
+
+            //Frames map to samples relative to a base; too late (stalled emulation) or too early (turbo) means the
+            //base no longer matches how emulation is running, so start again from this event
+            uint64_t at = basePosition + (pending.frame - baseFrame) * sampleRate / 60;
+            if (!synced || pending.frame < baseFrame || at + latency < position || at > position + latency * 4)
+            {
+                Rebase(pending.frame, position + latency);
+                at = position + latency;
+            }
+
+            if (at > position)
+            {
+                break;
+            }
+
+            Apply(pending.state);
+            havePending = false;
+        }
+
+        out[i] = Sample();
+        position++;
+    }
+}
+
+void AudioSynth::Rebase(uint64_t frame, uint64_t at)
+{
+    baseFrame = frame;
+    basePosition = at;
+    synced = true;
+}
+
+void AudioSynth::Apply(const AudioState& next)
+{
+    patterned = false;
+    for (uint8_t byte : next.pattern)
+    {
+        patterned |= byte != 0;
+    }
+
+    //XO-CHIP plays the 128 pattern bits at 4000 * 2^((pitch - 64) / 48) bits per second
+    step = patterned ? 4000.0 * std::pow(2.0, (next.pitch - 64) / 48.0) / sampleRate : buzzerHz / sampleRate;
+
+    //Restart the waveform when the sound starts, so every beep begins the same way
+    if (next.on && !state.on)
+    {
+        phase = 0;
+    }
+
+    state = next;
+}
+
+int16_t AudioSynth::Sample()
+{
+    if (!state.on)
+    {
+        return 0;
+    }
+
+    bool high;
+    if (!patterned)
+    {
+        high = phase < 0.5;
+        phase += step;
+        phase -= std::floor(phase);
+    }
+    else
+    {
+        int bit = static_cast<int>(phase);
+        high = (state.pattern[bit / 8] >> (7 - bit % 8)) & 1;
+        phase += step;
+        if (phase >= 128)
+        {
+            phase = std::fmod(phase, 128);
+        }
+    }
+
+    return high ? amplitude : -amplitude;
+}
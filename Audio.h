@@ -0,0 +1,93 @@
+#pragma once
+#include "CHIP8.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+//What the sound output should be doing - the buzzer on or off, and the XO-CHIP pattern and pitch it plays
+//An all-zero pattern (no F002 yet) plays the plain CHIP-8 buzzer tone instead
+struct AudioState
+{
+    bool on = false;
+    uint8_t pitch = 64;
+    std::array<uint8_t, 16> pattern = {};
+
+    bool operator!=(const AudioState& other) const
+    {
+        return on != other.on || pitch != other.pitch || pattern != other.pattern;
+    }
+};
+
+//The audio state a CHIP8 is in after its last frame
+AudioState CurrentAudioState(const CHIP8& cpu);
+
+//A change of audio state, stamped with the emulated frame it starts on
+struct AudioEvent
+{
+    uint64_t frame;
+    AudioState state;
+};
+
+//Lock-free single-producer/single-consumer ring of audio events, laid out like TraceBuffer
+//The emulation thread pushes state changes, the audio callback pops them - neither ever waits on the other.
+//A full ring refuses the push and the producer tries again next frame.
+class AudioQueue
+{
+public:
+    //capacity is rounded up to a power of two
+    explicit AudioQueue(size_t capacity = 256);
+
+    bool Push(const AudioEvent& event);
+    bool Pop(AudioEvent& event);
+
+private:
+    std::vector<AudioEvent> events;
+    size_t mask;
+
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+//Audio-thread side - turns the events from an AudioQueue into signed 16-bit mono samples
+//Event frames are mapped onto the output sample clock with a fixed latency, so state changes land 1/60s apart as they
+//were emulated even though they arrive in bursts. When emulation stalls or runs ahead (Fx0A, turbo, a slow host) the
+//mapping is reset on the next event rather than queueing up silence or backlog.
+class AudioSynth
+{
+public:
+    //bufferSamples is the device's callback size - the latency covers one buffer plus a couple of frames of jitter
+    AudioSynth(AudioQueue& queue, int sampleRate, int bufferSamples);
+
+    //Fill out with count samples - called from the audio callback, never blocks
+    void Render(int16_t* out, int count);
+
+private:
+    AudioQueue& queue;
+    const int sampleRate;
+    const uint64_t latency;
+
+    //Samples rendered so far, and the sample the frame baseFrame starts at
+    uint64_t position = 0;
+    uint64_t baseFrame = 0;
+    uint64_t basePosition = 0;
+    bool synced = false;
+
+    //Next event, popped but not due yet
+    AudioEvent pending;
+    bool havePending = false;
+
+    AudioState state;
+
+    //Buzzer cycles or pattern bits advanced per sample, and where playback is within them
+    bool patterned = false;
+    double step = 0;
+    double phase = 0;
+
+    static constexpr int16_t amplitude = 4000;
+    static constexpr double buzzerHz = 440.0;
+
+    void Rebase(uint64_t frame, uint64_t at);
+    void Apply(const AudioState& next);
+    int16_t Sample();
+};
@@ -0,0 +1,199 @@
+#include "Batch.h"
+#include "Analyzer.h"
+#include "CHIP8.h"
+#include "InputScript.h"
+#include "Scheduler.h"
+#include "WorkStealingPool.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+std::vector<BatchJob> LoadManifest(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open batch manifest " + path);
+    }
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t") == std::string::npos)
+        {
+            continue;
+        }
+
+        std::vector<std::string> fields;
+        std::string field;
+        std::istringstream stream(line);
+        if (line.find('\t') != std::string::npos)
+        {
+            while (std::getline(stream, field, '\t'))
+            {
+                fields.push_back(field);
+            }
+        }
+        else
+        {
+            while (stream >> field)
+            {
+                fields.push_back(field);
+            }
+        }
+
+        BatchJob job;
+        try
+        {
+            if (fields.size() != 3)
+            {
+                throw std::invalid_argument("expected 3 fields");
+            }
+            job.romPath = fields[0];
+            job.inputPath = fields[1] == "-" ? "" : fields[1];
+            job.frames = std::stol(fields[2]);
+        }
+        catch (const std::exception&)
+        {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected <rom> <input script or -> <frames>");
+        }
+
+        jobs.push_back(job);
+    }
+
+    return jobs;
+}
+
+BatchResult RunBatchJob(const BatchJob& job, const Options& options)
+{
+    BatchResult result;
+    auto tStart = std::chrono::steady_clock::now();
+
+    try
+    {
+        InputScript input;
+        if (!job.inputPath.empty())
+        {
+            input.Load(job.inputPath);
+        }
+
+        CHIP8 cpu(options.core);
+        cpu.Seed(options.seed);
+        cpu.idleSkip = options.idleSkip;
+        if (job.rom)
+        {
+            cpu.Init(job.rom->Data(), job.rom->Size());
+        }
+        else
+        {
+            cpu.Init(job.romPath);
+        }
+        //Jobs running the same ROM share one analysis
+        if (options.predecode)
+        {
+            cpu.Predecode(*AnalyzeCached(cpu.Memory()));
+        }
+        Scheduler scheduler(job.instructionRate > 0 ? job.instructionRate : options.InstructionRate(), true);
+
+        for (long frame = 0; frame < job.frames && !cpu.Halted(); frame++)
+        {
+            input.Apply(frame, cpu.keyboardState);
+            scheduler.RunFrame(cpu);
+        }
+
+        result.displayHash = cpu.DisplayHash();
+        result.cycles = cpu.cycleCount;
+    }
+    catch (const std::exception& e)
+    {
+        result.error = e.what();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+    return result;
+}
+
+int RunBatch(const Options& options)
+{
+    std::vector<BatchJob> jobs = LoadManifest(options.batchPath);
+    std::vector<BatchResult> results(jobs.size());
+
+    std::unique_ptr<RomLibrary> library;
+    if (!options.libraryPath.empty())
+    {
+        library = std::make_unique<RomLibrary>(options.libraryPath);
+        library->Scan();
+    }
+
+    //Map each distinct ROM once, however many jobs run it, and look up its profile by content hash
+    std::unordered_map<std::string, std::pair<std::shared_ptr<const RomImage>, int>> roms;
+    for (BatchJob& job : jobs)
+    {
+        auto loaded = roms.find(job.romPath);
+        if (loaded == roms.end())
+        {
+            std::shared_ptr<const RomImage> rom;
+            int rate = options.InstructionRate();
+            try
+            {
+                rom = std::make_shared<RomImage>(job.romPath);
+                const RomInfo* info = library ? library->Find(rom->Hash()) : nullptr;
+                if (info != nullptr)
+                {
+                    Options tuned = options;
+                    ApplyRomProfile(*info, tuned);
+                    rate = tuned.InstructionRate();
+                }
+            }
+            catch (const std::exception&)
+            {
+                //Left unmapped - the job maps it itself and reports the error
+            }
+            loaded = roms.emplace(job.romPath, std::make_pair(rom, rate)).first;
+        }
+
+        job.rom = loaded->second.first;
+        job.instructionRate = loaded->second.second;
+    }
+
+    //Every job writes only its own result slot, so the workers share nothing but the queues
+    std::vector<WorkStealingPool::Task> tasks;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        tasks.push_back([&, i]() { results[i] = RunBatchJob(jobs[i], options); });
+    }
+
+    auto tStart = std::chrono::steady_clock::now();
+    WorkStealingPool pool(options.threads);
+    pool.Run(std::move(tasks));
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+
+    //Results come out in manifest order, as tab-separated lines
+    int failed = 0;
+    std::cout << "rom\tframes\thash\tcycles\tseconds\terror\n";
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const BatchResult& result = results[i];
+        std::cout << jobs[i].romPath << '\t' << jobs[i].frames << '\t'
+                  << std::hex << std::setw(16) << std::setfill('0') << result.displayHash << std::dec << std::setfill(' ') << '\t'
+                  << result.cycles << '\t' << result.seconds << '\t' << (result.error.empty() ? "-" : result.error) << '\n';
+        if (!result.error.empty())
+        {
+            failed++;
+        }
+    }
+
+    std::cerr << jobs.size() << " jobs on " << options.threads << " threads in " << seconds << "s, " << failed << " failed\n";
+    return failed == 0 ? 0 : 1;
+}
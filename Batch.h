@@ -0,0 +1,39 @@
+#pragma once
+#include "Options.h"
+#include "RomLibrary.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+//One manifest line - run romPath for frames frames, feeding it inputPath (empty for no input)
+struct BatchJob
+{
+    std::string romPath;
+    std::string inputPath;
+    long frames;
+
+    //Filled in by RunBatch - the ROM mapped once and shared by every job that runs it (nullptr if it could not be
+    //mapped, in which case the job reports why), and its instructions per second after any library profile
+    std::shared_ptr<const RomImage> rom;
+    int instructionRate = 0;
+};
+
+struct BatchResult
+{
+    uint64_t displayHash = 0;
+    uint64_t cycles = 0;
+    double seconds = 0;
+    std::string error;
+};
+
+//Manifest format, one job per line: <rom> <input script or -> <frames>
+//Fields are tab-separated (so ROM names may contain spaces), or whitespace-separated on lines without tabs;
+//blank lines and lines starting with # are skipped. Throws std::runtime_error on unreadable or malformed manifests.
+std::vector<BatchJob> LoadManifest(const std::string& path);
+
+//Run a single job headlessly and unthrottled on the calling thread
+BatchResult RunBatchJob(const BatchJob& job, const Options& options);
+
+//Run every job in options.batchPath across options.threads workers and print one result line per job
+//With options.libraryPath each ROM's profile from the library sets its rate (unless --ipf/--rate was given)
+int RunBatch(const Options& options);
@@ -1,13 +1,94 @@
 #include "CHIP8.h"
+#include "Analyzer.h"
+#include "Jit.h"
+#include "Profiler.h"
+#include "RomLibrary.h"
+#include <cstdlib>
+
+CHIP8::CHIP8(Core core) : core(core)
+{
+}
+
+CHIP8::~CHIP8() = default;
+
+const char* CHIP8::CoreName(Core core)
+{
+    switch (core)
+    {
+        case Core::OpcodeTable: return "table";
+        case Core::Switch: return "switch";
+        case Core::BlockCache: return "block";
+        case Core::Jit: return "jit";
+    }
+
+    return "unknown";
+}
+
+const char* CHIP8::KindName(OpKind kind)
+{
+    static const char* const names[] =
+    {
+        "Invalid",
+        "CLS", "RET", "JP_1nnn", "CALL_2nnn", "SE_3xnn", "SNE_4xnn", "SE_5xy0", "LD_6xnn", "ADD_7xnn",
+        "LD_8xy0", "OR_8xy1", "AND_8xy2", "XOR_8xy3", "ADD_8xy4", "SUB_8xy5", "SHR_8xy6", "SUBN_8xy7", "SHL_8xyE",
+        "SNE_9xy0", "LD_Annn", "JP_Bnnn", "RND_Cxnn", "DRW_Dxyn", "SKP_Ex9E", "SKNP_ExA1",
+        "LD_Fx07", "LD_Fx0A", "LD_Fx15", "LD_Fx18", "ADD_Fx1E", "LD_Fx29", "LD_Fx33", "LD_Fx55", "LD_Fx65",
+        "SCD_00Cn", "SCU_00Dn", "SCR_00FB", "SCL_00FC", "EXIT_00FD", "LOW_00FE", "HIGH_00FF", "LD_5xy2", "LD_5xy3",
+        "LD_F000", "PLANE_Fn01", "AUDIO_F002", "LD_Fx30", "PITCH_Fx3A", "LD_Fx75", "LD_Fx85",
+        "DRW_6xnn_Annn_Dxyn", "DRW_Annn_Dxyn", "LD_Annn_Fx65", "SE_7xnn_3xnn", "SNE_7xnn_4xnn", "SE_Fx07_3xnn", "SNE_Fx07_4xnn"
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(OpKind::SNE_Fx07_4xnn) + 1, "KindName needs a name for every OpKind");
+    static_assert(sizeof(names) / sizeof(names[0]) <= ExecutionStats::maxKinds, "ExecutionStats::kinds needs a slot for every OpKind");
+
+    size_t i = static_cast<size_t>(kind);
+    return i < sizeof(names) / sizeof(names[0]) ? names[i] : "unknown";
+}
 
 void CHIP8::Init(const std::string& ROMPath)
 {
+    //One read-only mapping of the file, copied straight into RAM
+    RomImage rom(ROMPath);
+    Init(rom.Data(), rom.Size());
+}
+
+void CHIP8::Init(const uint8_t* rom, size_t size)
+{
+    //Load first, so a ROM that does not fit leaves the machine as it was
+    LoadROM(rom, size);
+
     curOpcode = 0;
     pc = 0;
     index = 0;
     sp = 0;
     delayTimer = 0;
     soundTimer = 0;
+    cycleCount = 0;
+    keyWait = KeyWait::None;
+    halted = false;
+    soundActive = false;
+    hires = false;
+    planeMask = 1;
+    for (Plane& plane : planes)
+    {
+        plane.fill(0);
+    }
+    audioPattern.fill(0);
+    pitch = 64;
+    Seed(rngSeed);
+
+    ResetCodeCaches();
+
+    //Traced and stats builds record every instruction, which native code cannot do, so the Jit core runs as the block
+    //cache there
+    jit.reset();
+    if (core == Core::Jit && CHIP8_TRACE_LEVEL == 0 && !CHIP8_STATS)
+    {
+        jit = std::make_unique<Jit>(*this);
+        if (!jit->Available())
+        {
+            jit.reset();
+        }
+    }
     
     //Load font into memory starting from 0x50
     uint8_t chip8_fontset[80] =
@@ -34,257 +115,1458 @@ void CHIP8::Init(const std::string& ROMPath)
     {
         RAM[i + 0x50] = chip8_fontset[i];
     }
-    
-    BuildOpCodes();
 
-    LoadROM(ROMPath);
+    //SUPER-CHIP 8x10 digits right after it at 0xA0, with XO-CHIP's A-F
+    uint8_t bigFontset[160] =
+    {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+    };
 
+    for (int i = 0; i < 160; i++)
+    {
+        RAM[i + 0xA0] = bigFontset[i];
+    }
+    
     pc = 512;
 }
 
-void CHIP8::LoadROM(const std::string& ROMPath)
+void CHIP8::LoadROM(const uint8_t* rom, size_t size)
+{
+    if (size > maxROMSize)
+    {
+        throw std::length_error("ROM is " + std::to_string(size) + " bytes, the most that fits is " + std::to_string(maxROMSize));
+    }
+
+    std::copy(rom, rom + size, RAM.begin() + 0x200);
+    std::fill(RAM.begin() + 0x200 + size, RAM.end(), 0);
+}
+
+void CHIP8::RunCycle()
+{
+    if (halted || (keyWait != KeyWait::None && !UpdateKeyWait()))
+    {
+        return;
+    }
+
+#if CHIP8_TRACE_LEVEL > 0
+    const uint16_t tracePC = pc;
+    const auto traceRegisters = registers;
+#endif
+#if CHIP8_STATS
+    const uint16_t statsPC = pc;
+#endif
+
+    //Fetch
+    curOpcode = (RAM[pc] << 8) | RAM[static_cast<uint16_t>(pc + 1)];
+
+    //Increment pc (need to increment by 2 due to the size of one instruction being 2 bytes)
+    //Incrementing before running the opcode avoids altering jump addresses after a cycle
+    pc += 2;
+
+    if (core != Core::OpcodeTable)
+    {
+        Execute(Decode(curOpcode));
+    }
+    else
+    {
+        auto& page = opcodeTable[curOpcode >> 8];
+        if (!page)
+        {
+            page = std::make_unique<OpcodePage>();
+        }
+
+        Instruction& instruction = (*page)[curOpcode & 0xFF];
+        if (!instruction)
+        {
+            instruction = BuildOpCode(curOpcode);
+        }
+
+        try
+        {
+            instruction();
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << "Failed to find/run instruction in opcodeTable: " << e.what() << '\n';
+        }
+    }
+
+#if CHIP8_TRACE_LEVEL > 0
+    TraceInstruction(cycleCount, tracePC, curOpcode, traceRegisters);
+#endif
+#if CHIP8_STATS
+    CountInstruction(statsPC, Decode(curOpcode).kind);
+#endif
+
+    cycleCount++;
+}
+
+#if CHIP8_TRACE_LEVEL > 0
+void CHIP8::TraceInstruction(uint64_t cycle, uint16_t address, uint16_t opcode, const std::array<uint8_t, 16>& before)
+{
+    if (trace == nullptr)
+    {
+        return;
+    }
+
+#if CHIP8_TRACE_LEVEL == 1
+    switch (Decode(opcode).kind)
+    {
+        case OpKind::JP_1nnn:
+        case OpKind::CALL_2nnn:
+        case OpKind::RET:
+        case OpKind::JP_Bnnn:
+        case OpKind::SE_3xnn:
+        case OpKind::SNE_4xnn:
+        case OpKind::SE_5xy0:
+        case OpKind::SNE_9xy0:
+        case OpKind::SKP_Ex9E:
+        case OpKind::SKNP_ExA1:
+            break;
+        default:
+            return;
+    }
+#endif
+
+    TraceRecord record;
+    record.cycle = cycle;
+    record.pc = address;
+    record.opcode = opcode;
+    record.index = index;
+    record.changedRegisters = 0;
+    record.registers = registers;
+    for (int i = 0; i < 16; i++)
+    {
+        if (registers[i] != before[i])
+        {
+            record.changedRegisters |= 1 << i;
+        }
+    }
+
+    trace->Push(record);
+}
+#endif
+
+void CHIP8::RunCycles(int count)
+{
+    if (profiler == nullptr)
+    {
+        RunInstructions(count);
+        return;
+    }
+
+    //Run up to each sample point, then let the profiler look at the stack there - a short run means the CPU stalled
+    //on Fx0A or halted, so nothing more can run this time
+    while (count > 0)
+    {
+        const int chunk = std::min(count, profiler->UntilSample());
+        const uint64_t before = cycleCount;
+        RunInstructions(chunk);
+
+        const uint64_t executed = cycleCount - before;
+        profiler->Advance(executed, *this);
+        count -= chunk;
+        if (executed < static_cast<uint64_t>(chunk))
+        {
+            return;
+        }
+    }
+}
+
+void CHIP8::RunInstructions(int count)
+{
+    //An Fx0A stalls the CPU until its key comes back up - the loops below stop as soon as one starts waiting (or 00FD halts)
+    if (halted || (keyWait != KeyWait::None && !UpdateKeyWait()))
+    {
+        return;
+    }
+
+    if (skipIdleLoops && idleSkip)
+    {
+        count -= SkipIdleLoop(count);
+    }
+
+    if (jit && jitEnabled)
+    {
+        while (count > 0 && Running())
+        {
+            //Blocks the JIT cannot run (or that do not fit in what is left of count) are stepped
+            int executed = jit->Run(count);
+            if (executed == 0)
+            {
+                RunCycle();
+                count--;
+            }
+            else
+            {
+                cycleCount += executed;
+                count -= executed;
+            }
+        }
+        return;
+    }
+
+    if (core == Core::OpcodeTable || core == Core::Switch)
+    {
+        for (int i = 0; i < count && Running(); i++)
+        {
+            RunCycle();
+        }
+        return;
+    }
+
+    while (count > 0 && Running())
+    {
+        std::unique_ptr<Block>& cached = CachedBlock(pc);
+        if (!cached)
+        {
+            cached = BuildBlock(pc);
+        }
+
+        //Anything BuildBlock refuses is stepped normally
+        Block* block = cached.get();
+        if (block == nullptr)
+        {
+            RunCycle();
+            count--;
+            continue;
+        }
+
+        //Only run as much of the block as the cycle budget allows - the rest gets its own block next dispatch
+        //Superinstructions (the last OpKinds) are charged every instruction they stand for, and one that does not fit
+        //stops the block
+        const int size = static_cast<int>(block->ops.size());
+        int executed = 0;
+        runningBlock = block;
+        blockInvalidated = false;
+
+        for (int i = 0; i < size && executed < count;)
+        {
+            const DecodedOp& op = block->ops[i];
+            int length = 1;
+            if (op.kind >= OpKind::DRW_6xnn_Annn_Dxyn)
+            {
+                length = FusedLength(op.kind);
+                if (executed + length > count)
+                {
+                    break;
+                }
+            }
+
+#if CHIP8_TRACE_LEVEL > 0
+            const uint16_t tracePC = pc;
+            const uint16_t traceOpcode = (RAM[pc] << 8) | RAM[static_cast<uint16_t>(pc + 1)];
+            const auto traceRegisters = registers;
+#endif
+#if CHIP8_STATS
+            CountInstruction(pc, op.kind);
+#endif
+
+            pc += 2 * length;
+            Execute(op);
+            executed += length;
+            i += length;
+
+#if CHIP8_TRACE_LEVEL > 0
+            TraceInstruction(cycleCount + executed - 1, tracePC, traceOpcode, traceRegisters);
+#endif
+
+            //An Fx33/Fx55/5xy2 wrote over cached code - the rest of this block may be stale
+            if (blockInvalidated)
+            {
+                break;
+            }
+        }
+
+        runningBlock = nullptr;
+        retiredBlock.reset();
+        cycleCount += executed;
+        count -= executed;
+
+        //The block starts with an idiom longer than what is left of count - step into it instead
+        if (executed == 0)
+        {
+            RunCycle();
+            count--;
+        }
+    }
+}
+
+//Instructions that read at most registers, I, timers, keys and RAM, and write at most registers, I and pc
+static bool IdleSafe(OpKind kind)
+{
+    switch (kind)
+    {
+        case OpKind::JP_1nnn:
+        case OpKind::JP_Bnnn:
+        case OpKind::SE_3xnn:
+        case OpKind::SNE_4xnn:
+        case OpKind::SE_5xy0:
+        case OpKind::SNE_9xy0:
+        case OpKind::SKP_Ex9E:
+        case OpKind::SKNP_ExA1:
+        case OpKind::LD_6xnn:
+        case OpKind::ADD_7xnn:
+        case OpKind::LD_8xy0:
+        case OpKind::OR_8xy1:
+        case OpKind::AND_8xy2:
+        case OpKind::XOR_8xy3:
+        case OpKind::ADD_8xy4:
+        case OpKind::SUB_8xy5:
+        case OpKind::SHR_8xy6:
+        case OpKind::SUBN_8xy7:
+        case OpKind::SHL_8xyE:
+        case OpKind::LD_Annn:
+        case OpKind::LD_Fx07:
+        case OpKind::ADD_Fx1E:
+        case OpKind::LD_Fx29:
+        case OpKind::LD_Fx30:
+        case OpKind::LD_Fx65:
+        case OpKind::LD_5xy3:
+        case OpKind::LD_F000:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int CHIP8::SkipIdleLoop(int count)
+{
+    //The state one iteration is compared against, and the step it was taken at - retaken whenever the loop does not
+    //come back to it within maxIdlePeriod, since the probe may have started on the way into the loop
+    std::array<uint8_t, 16> loopRegisters = registers;
+    uint16_t loopIndex = index;
+    uint16_t loopPC = pc;
+    int loopStart = 0;
+
+    int stepped = 0;
+    while (stepped < count && stepped < maxIdleProbe)
+    {
+        if (!IdleSafe(Decode((RAM[pc] << 8) | RAM[static_cast<uint16_t>(pc + 1)]).kind))
+        {
+            break;
+        }
+
+        RunCycle();
+        stepped++;
+
+        if (pc == loopPC && registers == loopRegisters && index == loopIndex)
+        {
+            const int period = stepped - loopStart;
+            const int skipped = (count - stepped) / period * period;
+            cycleCount += skipped;
+            return stepped + skipped;
+        }
+
+        if (pc == loopPC || stepped - loopStart >= maxIdlePeriod)
+        {
+            loopRegisters = registers;
+            loopIndex = index;
+            loopPC = pc;
+            loopStart = stepped;
+        }
+    }
+
+    return stepped;
+}
+
+void CHIP8::RunFrame()
+{
+    RunCycles(cyclesPerUpdate);
+    TickTimers();
+}
+
+void CHIP8::BeginKeyWait(uint8_t x)
+{
+    keyWait = KeyWait::Press;
+    keyWaitRegister = x;
+
+    //Keys already down when the wait starts only count once they have been let go and pressed again
+    keyWaitHeld = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        if (keyboardState[i])
+        {
+            keyWaitHeld |= 1 << i;
+        }
+    }
+}
+
+bool CHIP8::UpdateKeyWait()
+{
+    uint16_t keys = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        if (keyboardState[i])
+        {
+            keys |= 1 << i;
+        }
+    }
+
+    if (keyWait == KeyWait::Press)
+    {
+        uint16_t pressed = keys & ~keyWaitHeld;
+        keyWaitHeld = keys;
+        if (pressed == 0)
+        {
+            return false;
+        }
+
+        keyWaitKey = 0;
+        while (!(pressed & (1 << keyWaitKey)))
+        {
+            keyWaitKey++;
+        }
+        keyWait = KeyWait::Release;
+    }
+
+    if (keys & (1 << keyWaitKey))
+    {
+        return false;
+    }
+
+    registers[keyWaitRegister] = keyWaitKey;
+    keyWait = KeyWait::None;
+    return true;
+}
+
+void CHIP8::TickTimers()
+{
+#if CHIP8_STATS
+    if (stats != nullptr)
+    {
+        stats->framesComputed++;
+    }
+#endif
+
+    soundActive = soundTimer > 0;
+    if (delayTimer > 0)
+    {
+        delayTimer--;
+    }
+    if (soundTimer > 0)
+    {
+        soundTimer--;
+    }
+}
+
+uint64_t CHIP8::DisplayHash() const
+{
+    //Hash the words in use in the current mode byte by byte, most significant first, so the result does not depend on
+    //host endianness - plane 1 only once something is on it, so a lores CHIP-8 display hashes exactly its 32 rows
+    const bool secondPlane = std::any_of(planes[1].begin(), planes[1].end(), [](uint64_t word) { return word != 0; });
+    const int wordsPerRow = hires ? 2 : 1;
+
+    uint64_t hash = 0xCBF29CE484222325;
+    for (int p = 0; p < (secondPlane ? 2 : 1); p++)
+    {
+        for (int y = 0; y < Height(); y++)
+        {
+            for (int word = 0; word < wordsPerRow; word++)
+            {
+                uint64_t row = planes[p][y * 2 + word];
+                for (int shift = 56; shift >= 0; shift -= 8)
+                {
+                    hash ^= (row >> shift) & 0xFF;
+                    hash *= 0x100000001B3;
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+void CHIP8::Seed(uint32_t seed)
+{
+    rngSeed = seed;
+
+    //xorshift32 never leaves 0, so map it to some other fixed state
+    rngState = seed != 0 ? seed : 0x9E3779B9;
+}
+
+uint32_t CHIP8::Random()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+//Snapshot fields are written one after another in the order listed in SaveState.h, multi-byte values little-endian
+void CHIP8::SaveState(Snapshot& snapshot) const
+{
+    uint8_t* out = snapshot.bytes.data();
+    auto put = [&out](uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+        {
+            *out++ = static_cast<uint8_t>(value >> (i * 8));
+        }
+    };
+
+    put(Snapshot::magic, 4);
+    put(Snapshot::version, 2);
+    put(0, 2);
+
+    out = std::copy(RAM.begin(), RAM.end(), out);
+    out = std::copy(registers.begin(), registers.end(), out);
+    for (uint16_t address : stack)
+    {
+        put(address, 2);
+    }
+    put(sp, 1);
+    put(delayTimer, 1);
+    put(soundTimer, 1);
+    put(drawFlag, 1);
+    put(pc, 2);
+    put(index, 2);
+    for (const Plane& plane : planes)
+    {
+        for (uint64_t word : plane)
+        {
+            put(word, 8);
+        }
+    }
+    out = std::copy(keyboardState.begin(), keyboardState.end(), out);
+    put(rngState, 4);
+    put(rngSeed, 4);
+    put(cycleCount, 8);
+    put(static_cast<uint8_t>(keyWait), 1);
+    put(keyWaitRegister, 1);
+    put(keyWaitKey, 1);
+    put(0, 1);
+    put(keyWaitHeld, 2);
+    put(hires, 1);
+    put(planeMask, 1);
+    put(halted, 1);
+    put(pitch, 1);
+    out = std::copy(flagRegisters.begin(), flagRegisters.end(), out);
+    std::copy(audioPattern.begin(), audioPattern.end(), out);
+}
+
+bool CHIP8::LoadState(const Snapshot& snapshot)
+{
+    const uint8_t* in = snapshot.bytes.data();
+    auto get = [&in](int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++)
+        {
+            value |= static_cast<uint64_t>(*in++) << (i * 8);
+        }
+        return value;
+    };
+
+    if (get(4) != Snapshot::magic || get(2) != Snapshot::version)
+    {
+        return false;
+    }
+    get(2);
+
+    std::copy(in, in + RAM.size(), RAM.begin());
+    in += RAM.size();
+    std::copy(in, in + registers.size(), registers.begin());
+    in += registers.size();
+    for (uint16_t& address : stack)
+    {
+        address = static_cast<uint16_t>(get(2));
+    }
+    sp = static_cast<uint8_t>(get(1));
+    delayTimer = static_cast<uint8_t>(get(1));
+    soundTimer = static_cast<uint8_t>(get(1));
+    drawFlag = get(1) != 0;
+    pc = static_cast<uint16_t>(get(2));
+    index = static_cast<uint16_t>(get(2));
+    for (Plane& plane : planes)
+    {
+        for (uint64_t& word : plane)
+        {
+            word = get(8);
+        }
+    }
+    std::copy(in, in + keyboardState.size(), keyboardState.begin());
+    in += keyboardState.size();
+    rngState = static_cast<uint32_t>(get(4));
+    rngSeed = static_cast<uint32_t>(get(4));
+    cycleCount = get(8);
+    keyWait = static_cast<KeyWait>(std::min<uint64_t>(get(1), 2));
+    keyWaitRegister = static_cast<uint8_t>(get(1) & 0xF);
+    keyWaitKey = static_cast<uint8_t>(get(1) & 0xF);
+    get(1);
+    keyWaitHeld = static_cast<uint16_t>(get(2));
+    hires = get(1) != 0;
+    planeMask = static_cast<uint8_t>(get(1) & 3);
+    halted = get(1) != 0;
+    pitch = static_cast<uint8_t>(get(1));
+    std::copy(in, in + flagRegisters.size(), flagRegisters.begin());
+    in += flagRegisters.size();
+    std::copy(in, in + audioPattern.size(), audioPattern.begin());
+
+    //All of RAM may have changed under the cached and compiled code
+    ResetCodeCaches();
+
+    return true;
+}
+
+void CHIP8::ResetCodeCaches()
+{
+    for (auto& page : blockCache)
+    {
+        page.reset();
+    }
+    codeMap.fill(0);
+
+    if (jit)
+    {
+        jit->InvalidateCode(0, memorySize);
+    }
+}
+
+std::unique_ptr<CHIP8::Block>& CHIP8::CachedBlock(uint16_t address)
+{
+    auto& page = blockCache[address >> 8];
+    if (!page)
+    {
+        page = std::make_unique<BlockPage>();
+    }
+    return (*page)[address & 0xFF];
+}
+
+std::unique_ptr<CHIP8::Block>* CHIP8::FindBlock(uint16_t address)
+{
+    auto& page = blockCache[address >> 8];
+    return page ? &(*page)[address & 0xFF] : nullptr;
+}
+
+std::unique_ptr<CHIP8::Block> CHIP8::BuildBlock(uint16_t address)
+{
+    auto block = std::make_unique<Block>();
+    block->start = address;
+
+    //Blocks stop short of the last word so their end still fits in a uint16_t - code there is stepped
+    while (address < memorySize - 2 && block->ops.size() < maxBlockLength)
+    {
+        DecodedOp op = Decode((RAM[address] << 8) | RAM[address + 1]);
+
+        //Invalid opcodes are left to RunCycle so they get reported the same way as the other cores
+        if (op.kind == OpKind::Invalid)
+        {
+            break;
+        }
+
+        block->ops.push_back(op);
+        address += 2;
+
+        bool endsBlock = false;
+        switch (op.kind)
+        {
+            case OpKind::JP_1nnn:
+            case OpKind::CALL_2nnn:
+            case OpKind::RET:
+            case OpKind::JP_Bnnn:
+            case OpKind::SE_3xnn:
+            case OpKind::SNE_4xnn:
+            case OpKind::SE_5xy0:
+            case OpKind::SNE_9xy0:
+            case OpKind::SKP_Ex9E:
+            case OpKind::SKNP_ExA1:
+            case OpKind::LD_Fx0A:
+            case OpKind::EXIT_00FD:
+            case OpKind::LD_F000:
+                endsBlock = true;
+                break;
+            default:
+                break;
+        }
+
+        if (endsBlock)
+        {
+            break;
+        }
+    }
+
+    if (block->ops.empty())
+    {
+        return nullptr;
+    }
+
+    if (fuseBlocks)
+    {
+        FuseBlock(block->ops);
+    }
+
+    block->end = address;
+    for (int i = block->start; i < block->end; i++)
+    {
+        codeMap[i]++;
+    }
+
+    return block;
+}
+
+int CHIP8::FusedLength(OpKind kind)
 {
-    std::ifstream file(ROMPath, std::ios::binary);
-    FILE* filePtr = fopen(ROMPath.c_str(), "rb");
+    switch (kind)
+    {
+        case OpKind::DRW_6xnn_Annn_Dxyn:
+            return 3;
+        case OpKind::DRW_Annn_Dxyn:
+        case OpKind::LD_Annn_Fx65:
+        case OpKind::SE_7xnn_3xnn:
+        case OpKind::SNE_7xnn_4xnn:
+        case OpKind::SE_Fx07_3xnn:
+        case OpKind::SNE_Fx07_4xnn:
+            return 2;
+        default:
+            return 1;
+    }
+}
 
-    if (filePtr != nullptr)
+void CHIP8::FuseBlock(std::vector<DecodedOp>& ops)
+{
+    //Left to right, longest idiom first - an instruction only ever belongs to one superinstruction
+    size_t i = 0;
+    while (i < ops.size())
     {
-        auto fsize = file.tellg();
+        const OpKind first = ops[i].kind;
+        const OpKind second = i + 1 < ops.size() ? ops[i + 1].kind : OpKind::Invalid;
+        const OpKind third = i + 2 < ops.size() ? ops[i + 2].kind : OpKind::Invalid;
 
-        file.seekg(0, std::ios::end);
-        fsize = file.tellg() - fsize;
-        std::vector<uint8_t> bytes(fsize);
+        OpKind fused = first;
+        if (first == OpKind::LD_6xnn && second == OpKind::LD_Annn && third == OpKind::DRW_Dxyn)
+        {
+            //Sprite setup - a coordinate, the sprite's address, then the draw
+            fused = OpKind::DRW_6xnn_Annn_Dxyn;
+        }
+        else if (first == OpKind::LD_Annn && second == OpKind::DRW_Dxyn)
+        {
+            fused = OpKind::DRW_Annn_Dxyn;
+        }
+        else if (first == OpKind::LD_Annn && second == OpKind::LD_Fx65)
+        {
+            //Table load
+            fused = OpKind::LD_Annn_Fx65;
+        }
+        else if (first == OpKind::ADD_7xnn && second == OpKind::SE_3xnn)
+        {
+            //Loop counter step and test
+            fused = OpKind::SE_7xnn_3xnn;
+        }
+        else if (first == OpKind::ADD_7xnn && second == OpKind::SNE_4xnn)
+        {
+            fused = OpKind::SNE_7xnn_4xnn;
+        }
+        else if (first == OpKind::LD_Fx07 && second == OpKind::SE_3xnn)
+        {
+            //Timer poll
+            fused = OpKind::SE_Fx07_3xnn;
+        }
+        else if (first == OpKind::LD_Fx07 && second == OpKind::SNE_4xnn)
+        {
+            fused = OpKind::SNE_Fx07_4xnn;
+        }
 
-        std::fread(&bytes[0], sizeof(bytes[0]), fsize, filePtr);
+        ops[i].kind = fused;
+        i += FusedLength(fused);
+    }
+}
 
-        for (int i = 0; i < fsize; i++)
+void CHIP8::Predecode(const ProgramAnalysis& analysis)
+{
+    if (core == Core::OpcodeTable)
+    {
+        for (size_t address = 0; address + 1 < memorySize; address++)
+        {
+            if (analysis.bytes[address] != ProgramAnalysis::Byte::Opcode)
+            {
+                continue;
+            }
+
+            const uint16_t opcode = (RAM[address] << 8) | RAM[address + 1];
+            auto& page = opcodeTable[opcode >> 8];
+            if (!page)
+            {
+                page = std::make_unique<OpcodePage>();
+            }
+            Instruction& instruction = (*page)[opcode & 0xFF];
+            if (!instruction)
+            {
+                instruction = BuildOpCode(opcode);
+            }
+        }
+        return;
+    }
+
+    //The switch core has nothing cached to build
+    if (core == Core::Switch)
+    {
+        return;
+    }
+
+    for (const auto& block : analysis.blocks)
+    {
+        if (jit && jitEnabled)
         {
-            RAM[i + 0x200] = bytes[i];
+            jit->Precompile(block.first);
         }
+        else
+        {
+            std::unique_ptr<Block>& cached = CachedBlock(block.first);
+            if (!cached)
+            {
+                cached = BuildBlock(block.first);
+            }
+        }
+    }
+}
+
+void CHIP8::InvalidateCode(uint16_t address, int length)
+{
+    MarkWritten(address, length);
+
+    if (jit)
+    {
+        jit->InvalidateCode(address, length);
+    }
+
+    for (int a = address; a < address + length && a < static_cast<int>(memorySize); a++)
+    {
+        if (codeMap[a] == 0)
+        {
+            continue;
+        }
+
+        //A block covering a can only start up to maxBlockLength instructions before it
+        for (int start = std::max(0, a - maxBlockLength * 2 + 1); start <= a; start++)
+        {
+            std::unique_ptr<Block>* slot = FindBlock(start);
+            Block* block = slot != nullptr ? slot->get() : nullptr;
+            if (block == nullptr || a >= block->end)
+            {
+                continue;
+            }
+
+            for (int i = block->start; i < block->end; i++)
+            {
+                codeMap[i]--;
+            }
+
+            if (block == runningBlock)
+            {
+                retiredBlock = std::move(*slot);
+                blockInvalidated = true;
+            }
+            else
+            {
+                slot->reset();
+            }
+        }
+    }
+}
+
+//Decodes by the high nibble first, then by n/nn for the 0x0---, 0x5---, 0x8---, 0xE--- and 0xF--- groups
+//Accepts exactly the opcodes BuildOpCode assigns, so both cores agree on what is invalid
+DecodedOp CHIP8::Decode(uint16_t opcode)
+{
+    DecodedOp op;
+    op.kind = OpKind::Invalid;
+    op.x = (opcode & 0x0F00) >> 8;
+    op.y = (opcode & 0x00F0) >> 4;
+    op.n = opcode & 0x000F;
+    op.nn = opcode & 0x00FF;
+    op.nnn = opcode & 0x0FFF;
+
+    switch (opcode >> 12)
+    {
+        case 0x0:
+            if (opcode == 0x00E0) op.kind = OpKind::CLS;
+            else if (opcode == 0x00EE) op.kind = OpKind::RET;
+            else if ((opcode & 0xFFF0) == 0x00C0 && op.n != 0) op.kind = OpKind::SCD_00Cn;
+            else if ((opcode & 0xFFF0) == 0x00D0 && op.n != 0) op.kind = OpKind::SCU_00Dn;
+            else if (opcode == 0x00FB) op.kind = OpKind::SCR_00FB;
+            else if (opcode == 0x00FC) op.kind = OpKind::SCL_00FC;
+            else if (opcode == 0x00FD) op.kind = OpKind::EXIT_00FD;
+            else if (opcode == 0x00FE) op.kind = OpKind::LOW_00FE;
+            else if (opcode == 0x00FF) op.kind = OpKind::HIGH_00FF;
+            break;
+        case 0x1: op.kind = OpKind::JP_1nnn; break;
+        case 0x2: op.kind = OpKind::CALL_2nnn; break;
+        case 0x3: op.kind = OpKind::SE_3xnn; break;
+        case 0x4: op.kind = OpKind::SNE_4xnn; break;
+        case 0x5:
+            //5xy2/5xy3 are XO-CHIP, every other 5xyn is still an SE
+            if (op.n == 2) op.kind = OpKind::LD_5xy2;
+            else if (op.n == 3) op.kind = OpKind::LD_5xy3;
+            else op.kind = OpKind::SE_5xy0;
+            break;
+        case 0x6: op.kind = OpKind::LD_6xnn; break;
+        case 0x7: op.kind = OpKind::ADD_7xnn; break;
+        case 0x8:
+            switch (op.n)
+            {
+                case 0x0: op.kind = OpKind::LD_8xy0; break;
+                case 0x1: op.kind = OpKind::OR_8xy1; break;
+                case 0x2: op.kind = OpKind::AND_8xy2; break;
+                case 0x3: op.kind = OpKind::XOR_8xy3; break;
+                case 0x4: op.kind = OpKind::ADD_8xy4; break;
+                case 0x5: op.kind = OpKind::SUB_8xy5; break;
+                case 0x6: op.kind = OpKind::SHR_8xy6; break;
+                case 0x7: op.kind = OpKind::SUBN_8xy7; break;
+                case 0xE: op.kind = OpKind::SHL_8xyE; break;
+            }
+            break;
+        case 0x9:
+            if (op.n == 0) op.kind = OpKind::SNE_9xy0;
+            break;
+        case 0xA: op.kind = OpKind::LD_Annn; break;
+        case 0xB: op.kind = OpKind::JP_Bnnn; break;
+        case 0xC: op.kind = OpKind::RND_Cxnn; break;
+        case 0xD: op.kind = OpKind::DRW_Dxyn; break;
+        case 0xE:
+            if (op.nn == 0x9E) op.kind = OpKind::SKP_Ex9E;
+            else if (op.nn == 0xA1) op.kind = OpKind::SKNP_ExA1;
+            break;
+        case 0xF:
+            switch (op.nn)
+            {
+                case 0x00: if (opcode == 0xF000) op.kind = OpKind::LD_F000; break;
+                case 0x01: op.kind = OpKind::PLANE_Fn01; break;
+                case 0x02: if (opcode == 0xF002) op.kind = OpKind::AUDIO_F002; break;
+                case 0x07: op.kind = OpKind::LD_Fx07; break;
+                case 0x0A: op.kind = OpKind::LD_Fx0A; break;
+                case 0x15: op.kind = OpKind::LD_Fx15; break;
+                case 0x18: op.kind = OpKind::LD_Fx18; break;
+                case 0x1E: op.kind = OpKind::ADD_Fx1E; break;
+                case 0x29: op.kind = OpKind::LD_Fx29; break;
+                case 0x30: op.kind = OpKind::LD_Fx30; break;
+                case 0x33: op.kind = OpKind::LD_Fx33; break;
+                case 0x3A: op.kind = OpKind::PITCH_Fx3A; break;
+                case 0x55: op.kind = OpKind::LD_Fx55; break;
+                case 0x65: op.kind = OpKind::LD_Fx65; break;
+                case 0x75: op.kind = OpKind::LD_Fx75; break;
+                case 0x85: op.kind = OpKind::LD_Fx85; break;
+            }
+            //The table stops one short of 0xFFFF
+            if (opcode == 0xFFFF) op.kind = OpKind::Invalid;
+            break;
+    }
+
+    return op;
+}
+
+//Switch/BlockCache cores - same behaviour as the opcodeTable lambdas, without the std::function indirection
+void CHIP8::Execute(const DecodedOp& op)
+{
+    const uint8_t x = op.x;
+    const uint8_t y = op.y;
+
+    switch (op.kind)
+    {
+        case OpKind::CLS:
+            ClearPlanes();
+            break;
+        case OpKind::RET:
+            pc = stack[sp];
+            sp--;
+            break;
+        case OpKind::JP_1nnn:
+            pc = op.nnn;
+            break;
+        case OpKind::CALL_2nnn:
+            sp++;
+            stack[sp] = pc;
+            pc = op.nnn;
+            break;
+        case OpKind::SE_3xnn:
+            if (registers[x] == op.nn) Skip();
+            break;
+        case OpKind::SNE_4xnn:
+            if (registers[x] != op.nn) Skip();
+            break;
+        case OpKind::SE_5xy0:
+            if (registers[x] == registers[y]) Skip();
+            break;
+        case OpKind::LD_6xnn:
+            registers[x] = op.nn;
+            break;
+        case OpKind::ADD_7xnn:
+            registers[x] += op.nn;
+            break;
+        case OpKind::LD_8xy0:
+            registers[x] = registers[y];
+            break;
+        case OpKind::OR_8xy1:
+            registers[x] |= registers[y];
+            break;
+        case OpKind::AND_8xy2:
+            registers[x] &= registers[y];
+            break;
+        case OpKind::XOR_8xy3:
+            registers[x] ^= registers[y];
+            break;
+        case OpKind::ADD_8xy4:
+        {
+            registers[0xF] = 0;
+            uint16_t result = registers[x] + registers[y];
+            registers[x] += registers[y];
+            if (result > 0xFF) registers[0xF] = 1;
+            break;
+        }
+        case OpKind::SUB_8xy5:
+            registers[0xF] = 0;
+            if (registers[x] > registers[y]) registers[0xF] = 1;
+            registers[x] = registers[x] - registers[y];
+            break;
+        case OpKind::SHR_8xy6:
+            registers[0xF] = 0;
+            if ((registers[x] & 0x01) > 0) registers[0xF] = 1;
+            registers[x] = registers[x] >> 1;
+            break;
+        case OpKind::SUBN_8xy7:
+            registers[0xF] = 0;
+            if (registers[x] < registers[y]) registers[0xF] = 1;
+            registers[x] = registers[y] - registers[x];
+            break;
+        case OpKind::SHL_8xyE:
+            registers[0xF] = 0;
+            if ((registers[x] & 0x80) > 0) registers[0xF] = 1;
+            registers[x] = registers[x] << 1;
+            break;
+        case OpKind::SNE_9xy0:
+            if (registers[x] != registers[y]) Skip();
+            break;
+        case OpKind::LD_Annn:
+            index = op.nnn;
+            break;
+        case OpKind::JP_Bnnn:
+            pc = (op.nnn + registers[0]);
+            break;
+        case OpKind::RND_Cxnn:
+            registers[x] = (Random() % 255) & op.nn;
+            break;
+        case OpKind::DRW_Dxyn:
+            DrawSprite(x, y, op.n);
+            break;
+        case OpKind::SKP_Ex9E:
+            if (keyboardState[registers[x]] == 1) Skip();
+            break;
+        case OpKind::SKNP_ExA1:
+            if (keyboardState[registers[x]] == 0) Skip();
+            break;
+        case OpKind::LD_Fx07:
+            registers[x] = delayTimer;
+            break;
+        case OpKind::LD_Fx0A:
+            BeginKeyWait(x);
+            break;
+        case OpKind::LD_Fx15:
+            delayTimer = registers[x];
+            break;
+        case OpKind::LD_Fx18:
+            soundTimer = registers[x];
+            break;
+        case OpKind::ADD_Fx1E:
+            index += registers[x];
+            break;
+        case OpKind::LD_Fx29:
+            index = 0x50 + (registers[x] * 5);
+            break;
+        case OpKind::LD_Fx33:
+            RAM[index] = registers[x] / 100;
+            RAM[static_cast<uint16_t>(index + 1)] = (registers[x] % 100) / 10;
+            RAM[static_cast<uint16_t>(index + 2)] = (registers[x] % 100) % 10;
+            InvalidateCode(index, 3);
+            break;
+        case OpKind::LD_Fx55:
+            for (uint8_t i = 0; i <= x; i++) RAM[static_cast<uint16_t>(index + i)] = registers[i];
+            InvalidateCode(index, x + 1);
+            break;
+        case OpKind::LD_Fx65:
+            for (uint8_t i = 0; i <= x; i++) registers[i] = RAM[static_cast<uint16_t>(index + i)];
+            break;
+        case OpKind::SCD_00Cn:
+            ScrollVertical(op.n);
+            break;
+        case OpKind::SCU_00Dn:
+            ScrollVertical(-op.n);
+            break;
+        case OpKind::SCR_00FB:
+            ScrollHorizontal(4);
+            break;
+        case OpKind::SCL_00FC:
+            ScrollHorizontal(-4);
+            break;
+        case OpKind::EXIT_00FD:
+            halted = true;
+            break;
+        case OpKind::LOW_00FE:
+            SetResolution(false);
+            break;
+        case OpKind::HIGH_00FF:
+            SetResolution(true);
+            break;
+        case OpKind::LD_5xy2:
+        {
+            const int step = x <= y ? 1 : -1;
+            for (int i = 0; i <= std::abs(y - x); i++) RAM[static_cast<uint16_t>(index + i)] = registers[x + i * step];
+            InvalidateCode(index, std::abs(y - x) + 1);
+            break;
+        }
+        case OpKind::LD_5xy3:
+        {
+            const int step = x <= y ? 1 : -1;
+            for (int i = 0; i <= std::abs(y - x); i++) registers[x + i * step] = RAM[static_cast<uint16_t>(index + i)];
+            break;
+        }
+        case OpKind::LD_F000:
+            index = (RAM[pc] << 8) | RAM[static_cast<uint16_t>(pc + 1)];
+            pc += 2;
+            break;
+        case OpKind::PLANE_Fn01:
+            planeMask = x & 3;
+            break;
+        case OpKind::AUDIO_F002:
+            for (int i = 0; i < 16; i++) audioPattern[i] = RAM[static_cast<uint16_t>(index + i)];
+            break;
+        case OpKind::LD_Fx30:
+            index = 0xA0 + (registers[x] & 0xF) * 10;
+            break;
+        case OpKind::PITCH_Fx3A:
+            pitch = registers[x];
+            break;
+        case OpKind::LD_Fx75:
+            for (uint8_t i = 0; i <= x; i++) flagRegisters[i] = registers[i];
+            break;
+        case OpKind::LD_Fx85:
+            for (uint8_t i = 0; i <= x; i++) registers[i] = flagRegisters[i];
+            break;
+        case OpKind::DRW_6xnn_Annn_Dxyn:
+            registers[x] = op.nn;
+            index = (&op)[1].nnn;
+            DrawSprite((&op)[2].x, (&op)[2].y, (&op)[2].n);
+            break;
+        case OpKind::DRW_Annn_Dxyn:
+            index = op.nnn;
+            DrawSprite((&op)[1].x, (&op)[1].y, (&op)[1].n);
+            break;
+        case OpKind::LD_Annn_Fx65:
+            index = op.nnn;
+            for (uint8_t i = 0; i <= (&op)[1].x; i++) registers[i] = RAM[static_cast<uint16_t>(index + i)];
+            break;
+        case OpKind::SE_7xnn_3xnn:
+            registers[x] += op.nn;
+            if (registers[(&op)[1].x] == (&op)[1].nn) Skip();
+            break;
+        case OpKind::SNE_7xnn_4xnn:
+            registers[x] += op.nn;
+            if (registers[(&op)[1].x] != (&op)[1].nn) Skip();
+            break;
+        case OpKind::SE_Fx07_3xnn:
+            registers[x] = delayTimer;
+            if (registers[(&op)[1].x] == (&op)[1].nn) Skip();
+            break;
+        case OpKind::SNE_Fx07_4xnn:
+            registers[x] = delayTimer;
+            if (registers[(&op)[1].x] != (&op)[1].nn) Skip();
+            break;
+        case OpKind::Invalid:
+            std::cerr << "Failed to decode instruction: " << std::hex << curOpcode << '\n';
+            break;
+    }
+}
+
+CHIP8::Instruction CHIP8::BuildOpCode(uint16_t opcode)
+{
+    //Instructions with 0x0nnn opcodes
+    if (opcode == 0x00E0)
+    {
+        //CLS
+        return CLS();
+    }
+    if (opcode == 0x00EE)
+    {
+        //RET
+        return RET();
+    }
+    if ((opcode & 0xFFF0) == 0x00C0 && (opcode & 0x000F) != 0)
+    {
+        //SCD scroll the display down n rows
+        return SCD_00Cn(opcode & 0x000F);
+    }
+    if ((opcode & 0xFFF0) == 0x00D0 && (opcode & 0x000F) != 0)
+    {
+        //SCU scroll the display up n rows
+        return SCU_00Dn(opcode & 0x000F);
+    }
+    if (opcode == 0x00FB)
+    {
+        //SCR scroll the display right 4 pixels
+        return SCR_00FB();
+    }
+    if (opcode == 0x00FC)
+    {
+        //SCL scroll the display left 4 pixels
+        return SCL_00FC();
+    }
+    if (opcode == 0x00FD)
+    {
+        //EXIT stop the interpreter
+        return EXIT_00FD();
+    }
+    if (opcode == 0x00FE)
+    {
+        //LOW switch to 64x32
+        return LOW_00FE();
+    }
+    if (opcode == 0x00FF)
+    {
+        //HIGH switch to 128x64
+        return HIGH_00FF();
+    }
+    if (opcode == 0xF000)
+    {
+        //LD I = the 16-bit word after the instruction
+        return LD_F000();
+    }
+    if (opcode == 0xF002)
+    {
+        //AUDIO load the 16-byte audio pattern from RAM[index]
+        return AUDIO_F002();
+    }
+
+    uint16_t nnn = opcode & 0x0FFF;
+    uint8_t nn = opcode & 0x00FF;
+    uint8_t n = opcode & 0x000F;
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+
+    if ((opcode & 0xF000) == 0x1000)
+    {
+        //JP pc = nnn
+        return JP_1nnn(nnn);
+    }
+    else if ((opcode & 0xF000) == 0x2000)
+    {
+        //CALL pc goes on stack, then pc = nnn
+        return CALL_2nnn(nnn);
+    }
+    else if ((opcode & 0xF000) == 0x3000)
+    {
+        //SE skip if Vx == nn
+        return SE_3xnn(x, nn);
+    }
+    else if ((opcode & 0xF000) == 0x4000)
+    {
+        //SNE skip if Vx != nn
+        return SNE_4xnn(x, nn);
+    }
+    else if ((opcode & 0xF00F) == 0x5002)
+    {
+        //LD save Vx through Vy to RAM[index] onwards (in descending order if x > y)
+        return LD_5xy2(x, y);
+    }
+    else if ((opcode & 0xF00F) == 0x5003)
+    {
+        //LD load Vx through Vy from RAM[index] onwards
+        return LD_5xy3(x, y);
+    }
+    else if ((opcode & 0xF000) == 0x5000)
+    {
+        //SE skip if Vx == Vy
+        return SE_5xy0(x, y);
+    }
+    else if ((opcode & 0xF000) == 0x6000)
+    {
+        //LD Vx = nn
+        return LD_6xnn(x, nn);
+    }
+    else if ((opcode & 0xF000) == 0x7000)
+    {
+        //ADD Vx += nn
+        return ADD_7xnn(x, nn);
+    }
+    //0x8--- instructions
+    else if ((opcode & 0xF000) == 0x8000)
+    {
+        if (n == 0)
+        {
+            //LD Vx = Vy
+            return LD_8xy0(x, y);
+        }
+        else if (n == 1)
+        {
+            //OR Vx || Vy
+            return OR_8xy1(x, y);
+        }
+        else if (n == 2)
+        {
+            //AND Vx & Vy
+            return AND_8xy2(x, y);
+        }
+        else if (n == 3)
+        {
+            //XOR Vx ^ Vy
+            return XOR_8xy3(x, y);
+        }
+        else if (n == 4)
+        {
+            //ADD Vx += Vy and set VF = carry
+            return ADD_8xy4(x, y);
+        }
+        else if (n == 5)
+        {
+            //SUB Vx -= Vy and set VF = carry
+            return SUB_8xy5(x, y);
+        }
+        else if (n == 6)
+        {
+            //SHR (shift right) Vx = Vx >> 1; store LSB of Vx in VF and then divides Vx / 2
+            return SHR_8xy6(x, y);
+        }
+        else if (n == 7)
+        {
+            //SUBN Vx = Vy - Vx and set VF = !(borrow)
+            return SUBN_8xy7(x, y);
+        }
+        else if (n == 14)
+        {
+            //SHL Vx = Vx << 1; store LSB of Vx in VF, then multiply Vx * 2
+            return SHL_8xyE(x, y);
+        }
+    }
+    else if ((opcode & 0xF00F) == 0x9000)
+    {
+        //SNE skip if Vx != Vy
+        return SNE_9xy0(x, y);
+    }
+    else if ((opcode & 0xF000) == 0xA000)
+    {
+        //LD I = nnn
+        return LD_Annn(nnn);
+    }
+    else if ((opcode & 0xF000) == 0xB000)
+    {
+        //JP pc = nnn + V0
+        return JP_Bnnn(nnn);
+    }
+    else if ((opcode & 0xF000) == 0xC000)
+    {
+        //RND generate random number [0, 255], then Vx = rng & nn
+        return RND_Cxnn(x, nn);
     }
-    else
+    else if ((opcode & 0xF000) == 0xD000)
     {
-        std::cerr << "File failed to open";
+        //DRW_Dxyn draw(Vx, Vy, n)
+        return DRW_Dxyn(x, y, n);
     }
-
-    file.close();
-    fclose(filePtr);
-}
-
-void CHIP8::RunCycle()
-{
-    std::cerr << "PC at " << pc << '\n';
-
-    //Fetch
-    curOpcode = (RAM[pc] << 8) | RAM[pc + 1];
-
-    //Increment pc (need to increment by 2 due to the size of one instruction being 2 bytes)
-    //Incrementing before running the opcode avoids altering jump addresses after a cycle
-    pc += 2;
-
-    std::cerr << "Running opcode: " << std::hex << curOpcode << '\n';
-    try
+    else if ((opcode & 0xF0FF) == 0xE09E)
     {
-        opcodeTable[curOpcode]();
+        //SKP skip if the key with the value in Vx is pressed
+        return SKP_Ex9E(x);
     }
-    catch(const std::exception& e)
+    else if ((opcode & 0xF0FF) == 0xE0A1)
     {
-        std::cerr << "Failed to find/run instruction in opcodeTable: " << e.what() << '\n';
+        //SKNP skip if the key with the value in Vx is not pressed
+        return SKNP_ExA1(x);
     }
-}
-
-void CHIP8::BuildOpCodes()
-{
-    //Instructions with 0x0nnn opcodes
-    //CLS
-    opcodeTable[0x00E0] = CLS();
-    //RET
-    opcodeTable[0x00EE] = RET();
-
-    for (int opcode = 0x1000; opcode < 0xFFFF; opcode++)
+    //0xF--- instructions
+    else if ((opcode & 0xF000) == 0xF000)
     {
-        uint16_t nnn = opcode & 0x0FFF;
-        uint8_t nn = opcode & 0x00FF;
-        uint8_t n = opcode & 0x000F;
-        uint8_t x = (opcode & 0x0F00) >> 8;
-        uint8_t y = (opcode & 0x00F0) >> 4;
-
-        if ((opcode & 0xF000) == 0x1000)
-        {
-            //JP pc = nnn
-            opcodeTable[opcode] = JP_1nnn(nnn);
-        }
-        else if ((opcode & 0xF000) == 0x2000)
-        {
-            //CALL pc goes on stack, then pc = nnn
-            opcodeTable[opcode] = CALL_2nnn(nnn);
-        }
-        else if ((opcode & 0xF000) == 0x3000)
+        if (nn == 0x01)
         {
-            //SE skip if Vx == nn
-            opcodeTable[opcode] = SE_3xnn(x, nn);
+            //PLANE select the bit planes drawing, clearing and scrolling apply to (n = x)
+            return PLANE_Fn01(x);
         }
-        else if ((opcode & 0xF000) == 0x4000)
+        else if (nn == 0x07)
         {
-            //SNE skip if Vx != nn
-            opcodeTable[opcode] = SNE_4xnn(x, nn);
+            //LD Vx = DT (the delay timer value)
+            return LD_Fx07(x);
         }
-        else if ((opcode & 0xF000) == 0x5000)
+        else if (nn == 0x0A)
         {
-            //SE skip if Vx == Vy
-            opcodeTable[opcode] = SE_5xy0(x, y);
+            //LD Vx = value of pressed key (everything waits until a key is pressed)
+            return LD_Fx0A(x);
         }
-        else if ((opcode & 0xF000) == 0x6000)
+        else if (nn == 0x15)
         {
-            //LD Vx = nn
-            opcodeTable[opcode] = LD_6xnn(x, nn);
+            //LD DT = Vx
+            return LD_Fx15(x);
         }
-        else if ((opcode & 0xF000) == 0x7000)
+        else if (nn == 0x18)
         {
-            //ADD Vx += nn
-            opcodeTable[opcode] = ADD_7xnn(x, nn);
+            //LD ST = Vx
+            return LD_Fx18(x);
         }
-        //0x8--- instructions
-        else if ((opcode & 0xF000) == 0x8000)
+        else if (nn == 0x1E)
         {
-            if (n == 0)
-            {
-                //LD Vx = Vy
-                opcodeTable[opcode] = LD_8xy0(x, y);
-            }
-            else if (n == 1)
-            {
-                //OR Vx || Vy
-                opcodeTable[opcode] = OR_8xy1(x, y);
-            }
-            else if (n == 2)
-            {
-                //AND Vx & Vy
-                opcodeTable[opcode] = AND_8xy2(x, y);
-            }
-            else if (n == 3)
-            {
-                //XOR Vx ^ Vy
-                opcodeTable[opcode] = XOR_8xy3(x, y);
-            }
-            else if (n == 4)
-            {
-                //ADD Vx += Vy and set VF = carry
-                opcodeTable[opcode] = ADD_8xy4(x, y);
-            }
-            else if (n == 5)
-            {
-                //SUB Vx -= Vy and set VF = carry
-                opcodeTable[opcode] = SUB_8xy5(x, y);
-            }
-            else if (n == 6)
-            {
-                //SHR (shift right) Vx = Vx >> 1; store LSB of Vx in VF and then divides Vx / 2
-                opcodeTable[opcode] = SHR_8xy6(x, y);
-            }
-            else if (n == 7)
-            {
-                //SUBN Vx = Vy - Vx and set VF = !(borrow)
-                opcodeTable[opcode] = SUBN_8xy7(x, y);
-            }
-            else if (n == 14)
-            {
-                //SHL Vx = Vx << 1; store LSB of Vx in VF, then multiply Vx * 2
-                opcodeTable[opcode] = SHL_8xyE(x, y);
-            }
+            //ADD index += Vx
+            return ADD_Fx1E(x);
         }
-        else if ((opcode & 0xF00F) == 0x9000)
+        else if (nn == 0x29)
         {
-            //SNE skip if Vx != Vy
-            opcodeTable[opcode] = SNE_9xy0(x, y);
+            //LD I = memory location for the font sprite of Vx
+            return LD_Fx29(x);
         }
-        else if ((opcode & 0xF000) == 0xA000)
+        else if (nn == 0x30)
         {
-            //LD I = nnn
-            opcodeTable[opcode] = LD_Annn(nnn);
+            //LD I = memory location for the big font sprite of Vx
+            return LD_Fx30(x);
         }
-        else if ((opcode & 0xF000) == 0xB000)
+        else if (nn == 0x3A)
         {
-            //JP pc = nnn + V0
-            opcodeTable[opcode] = JP_Bnnn(nnn);
+            //PITCH set the audio pattern playback pitch to Vx
+            return PITCH_Fx3A(x);
         }
-        else if ((opcode & 0xF000) == 0xC000)
+        else if (nn == 0x33)
         {
-            //RND generate random number [0, 255], then Vx = rng & nn
-            opcodeTable[opcode] = RND_Cxnn(x, nn);
+            //LD store binary-coded decimal representation of Vx (RAM[index] = hundreds, RAM[index+1] = tens, RAM[index+2] = ones)
+            return LD_Fx33(x);
         }
-        else if ((opcode & 0xF000) == 0xD000)
+        else if (nn == 0x55)
         {
-            //DRW_Dxyn draw(Vx, Vy, n)
-            opcodeTable[opcode] = DRW_Dxyn(x, y, n);
+            //LD set RAM[index] through RAM[index + x] = V0 through Vx
+            return LD_Fx55(x);
         }
-        else if ((opcode & 0xF0FF) == 0xE09E)
+        else if (nn == 0x65)
         {
-            //SKP skip if the key with the value in Vx is pressed
-            opcodeTable[opcode] = SKP_Ex9E(x);
+            //LD set registers V0 through Vx = RAM[index] through RAM[index + x]
+            return LD_Fx65(x);
         }
-        else if ((opcode & 0xF0FF) == 0xE0A1)
+        else if (nn == 0x75)
         {
-            //SKNP skip if the key with the value in Vx is not pressed
-            opcodeTable[opcode] = SKNP_ExA1(x);
+            //LD save V0 through Vx to the flag registers
+            return LD_Fx75(x);
         }
-        //0xF--- instructions
-        else if ((opcode & 0xF000) == 0xF000)
+        else if (nn == 0x85)
         {
-            if (nn == 0x07)
-            {
-                //LD Vx = DT (the delay timer value)
-                opcodeTable[opcode] = LD_Fx07(x);
-            }
-            else if (nn == 0x0A)
-            {
-                //LD Vx = value of pressed key (everything waits until a key is pressed)
-                opcodeTable[opcode] = LD_Fx0A(x);
-            }
-            else if (nn == 0x15)
-            {
-                //LD DT = Vx
-                opcodeTable[opcode] = LD_Fx15(x);
-            }
-            else if (nn == 0x18)
-            {
-                //LD ST = Vx
-                opcodeTable[opcode] = LD_Fx18(x);
-            }
-            else if (nn == 0x1E)
-            {
-                //ADD index += Vx
-                opcodeTable[opcode] = ADD_Fx1E(x);
-            }
-            else if (nn == 0x29)
-            {
-                //LD I = memory location for the font sprite of Vx
-                opcodeTable[opcode] = LD_Fx29(x);
-            }
-            else if (nn == 0x33)
-            {
-                //LD store binary-coded decimal representation of Vx (RAM[index] = hundreds, RAM[index+1] = tens, RAM[index+2] = ones)
-                opcodeTable[opcode] = LD_Fx33(x);
-            }
-            else if (nn == 0x55)
-            {
-                //LD set RAM[index] through RAM[index + x] = V0 through Vx
-                opcodeTable[opcode] = LD_Fx55(x);
-            }
-            else if (nn == 0x65)
-            {
-                //LD set registers V0 through Vx = RAM[index] through RAM[index + x]
-                opcodeTable[opcode] = LD_Fx65(x);
-            }
+            //LD load V0 through Vx from the flag registers
+            return LD_Fx85(x);
         }
     }
+
+    //Unassigned opcodes get an empty Instruction, which RunCycle reports when it is called
+    return nullptr;
 }
 
 CHIP8::Instruction CHIP8::CLS()
 {
     return [this]() {
-        std::fill(display.begin(), display.end(), 0);
-        drawFlag = true;
+        ClearPlanes();
     };
 }
 
@@ -321,7 +1603,7 @@ CHIP8::Instruction CHIP8::SE_3xnn(uint8_t x, uint8_t nn)
     {
         if (registers[x] == nn)
         {
-            pc += 2;
+            Skip();
         }
     };
 }
@@ -332,7 +1614,7 @@ CHIP8::Instruction CHIP8::SNE_4xnn(uint8_t x, uint8_t nn)
     {
         if (registers[x] != nn)
         {
-            pc += 2;
+            Skip();
         }
     };
 }
@@ -343,7 +1625,7 @@ CHIP8::Instruction CHIP8::SE_5xy0(uint8_t x, uint8_t y)
     {
         if (registers[x] == registers[y])
         {
-            pc += 2;
+            Skip();
         }
     };
 }
@@ -494,7 +1776,7 @@ CHIP8::Instruction CHIP8::SNE_9xy0(uint8_t x, uint8_t y)
     {
         if (registers[x] != registers[y])
         {
-            pc += 2;
+            Skip();
         }
     };
 }
@@ -519,7 +1801,7 @@ CHIP8::Instruction CHIP8::RND_Cxnn(uint8_t x, uint8_t nn)
 {
     return [this, x, nn]()
     {
-        uint8_t randNum = std::rand() % 255;
+        uint8_t randNum = Random() % 255;
 
         registers[x] = randNum & nn;
     };
@@ -527,42 +1809,204 @@ CHIP8::Instruction CHIP8::RND_Cxnn(uint8_t x, uint8_t nn)
 
 //Draw sprite 8 pixels wide and n high at (Vx, Vy) using a sprite from the address the I register points to
 //x and y indicate which registers to use, n determines how many rows high the sprite is (and therefore how many bytes to read from I)
-//The display pixel vector uses 1 uint8_t for each pixel, while the bytes loaded from the index register use 1 bit per pixel
 CHIP8::Instruction CHIP8::DRW_Dxyn(uint8_t x, uint8_t y, uint8_t n)
 {
     return [this, x, y ,n]()
     {
-        //Get the coordinates from Vx and Vy (and adjust if they are off the screen)
-        uint8_t xCoordinate = registers[x]; //% 64;
-        uint8_t yCoordinate = registers[y]; //% 32;
-        uint8_t curPixelByte;
+        DrawSprite(x, y, n);
+    };
+}
 
-        //Set register VF to 0 - it will be set to 1 if any pixels overlap and are both on
-        registers[0xF] = 0;
+//Each display row is one uint64_t per 64 pixels with x = 0 in the top bit, so a sprite row is its 8 (or 16) bits moved
+//to the top of a word and rotated right by Vx - in lores that is one 64-bit rotate (wrapping pixels past the right edge
+//back to the left, like the % 64 did), in hires a 128-bit rotate done as two word shifts. Either way collision is an
+//AND and the draw an XOR per word, so a 16x16 hires sprite costs about what an 8-wide lores one did.
+//XO-CHIP sprites with both planes selected are the plane 0 rows followed by the plane 1 rows.
+void CHIP8::DrawSprite(uint8_t x, uint8_t y, uint8_t n)
+{
+    //Both sizes are powers of two, so wrapping is a mask rather than a divide
+    const int rowMask = Height() - 1;
+    const unsigned shift = registers[x] & (Width() - 1);
+    const int top = registers[y] & rowMask;
+    const int rows = n == 0 ? 16 : n;
+    uint16_t address = index;
+    bool collision = false;
+
+    //Next sprite row from I onwards, at the top of a word
+    auto fetch = [&]()
+    {
+        uint64_t row;
+        if (n == 0)
+        {
+            row = static_cast<uint64_t>((RAM[address] << 8) | RAM[static_cast<uint16_t>(address + 1)]) << 48;
+            address += 2;
+        }
+        else
+        {
+            row = static_cast<uint64_t>(RAM[address]) << 56;
+            address += 1;
+        }
+        return row;
+    };
 
-        //Loop through n rows of 8 pixels
-        for (int i = 0; i < n; i++)
+    for (int p = 0; p < 2; p++)
+    {
+        if (!(planeMask & (1 << p)))
         {
-            curPixelByte = RAM[index + i];
+            continue;
+        }
 
-            for (int j = 0; j < 8; j++)
-            { 
-                //AND the byte from index with a bitmask to check if this bit is 1
-                if ((curPixelByte & (0b10000000 >> j)) != 0)
-                {
-                    //Set VF=1 if pixel[bit j] AND display are both 1
-                    if (display[(((yCoordinate + i) % 32) * 64) + ((xCoordinate + j) % 64)] == 1)
-                    {
-                        registers[0xF] = 1;
-                    }
+        Plane& plane = planes[p];
+        if (!hires)
+        {
+            for (int i = 0; i < rows; i++)
+            {
+                uint64_t row = fetch();
+                row = (row >> shift) | (row << ((64 - shift) % 64));
 
-                    display[(((yCoordinate + i) % 32) * 64) + ((xCoordinate + j) % 64)] ^= 1;
-                }
+                uint64_t& displayRow = plane[((top + i) & rowMask) * 2];
+                collision |= (displayRow & row) != 0;
+                displayRow ^= row;
             }
         }
+        else
+        {
+            //The sprite starts in the word Vx falls in and spills into the one to its right (wrapping to the left edge)
+            const unsigned bit = shift % 64;
+            const int firstWord = shift / 64;
+            for (int i = 0; i < rows; i++)
+            {
+                const uint64_t row = fetch();
+                const uint64_t first = row >> bit;
+                const uint64_t spill = bit != 0 ? row << (64 - bit) : 0;
+
+                uint64_t* displayRow = &plane[((top + i) & rowMask) * 2];
+                uint64_t& left = displayRow[firstWord];
+                uint64_t& right = displayRow[firstWord ^ 1];
+                collision |= ((left & first) | (right & spill)) != 0;
+                left ^= first;
+                right ^= spill;
+            }
+        }
+    }
 
-        drawFlag = true;    
-    };
+    //VF = 1 if any pixel was turned off (Vx/Vy were read above, so this is right even when they are VF)
+    registers[0xF] = collision ? 1 : 0;
+    drawFlag = true;
+
+#if CHIP8_STATS
+    if (stats != nullptr)
+    {
+        stats->draws++;
+        stats->rowsDrawn += rows;
+        stats->collisions += collision;
+    }
+#endif
+}
+
+void CHIP8::ClearPlanes()
+{
+    for (int p = 0; p < 2; p++)
+    {
+        if (planeMask & (1 << p))
+        {
+            planes[p].fill(0);
+        }
+    }
+    drawFlag = true;
+}
+
+//Whole rows move as blocks of words - rows is in pixels of the current mode, positive for down
+void CHIP8::ScrollVertical(int rows)
+{
+    const int words = Height() * 2;
+    const int moved = std::min(std::abs(rows), Height()) * 2;
+
+    for (int p = 0; p < 2; p++)
+    {
+        if (!(planeMask & (1 << p)))
+        {
+            continue;
+        }
+
+        auto begin = planes[p].begin();
+        if (rows > 0)
+        {
+            std::copy_backward(begin, begin + words - moved, begin + words);
+            std::fill(begin, begin + moved, 0);
+        }
+        else
+        {
+            std::copy(begin + moved, begin + words, begin);
+            std::fill(begin + words - moved, begin + words, 0);
+        }
+    }
+    drawFlag = true;
+}
+
+//Each row shifts as one 64-bit word in lores, or as a 128-bit value (two words carrying into each other) in hires
+//pixels is positive for right - pixels shifted off the edge are lost
+void CHIP8::ScrollHorizontal(int pixels)
+{
+    const int height = Height();
+    const unsigned amount = std::abs(pixels);
+
+    for (int p = 0; p < 2; p++)
+    {
+        if (!(planeMask & (1 << p)))
+        {
+            continue;
+        }
+
+        Plane& plane = planes[p];
+        if (!hires)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                plane[y * 2] = pixels > 0 ? plane[y * 2] >> amount : plane[y * 2] << amount;
+            }
+        }
+        else if (pixels > 0)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                plane[y * 2 + 1] = (plane[y * 2 + 1] >> amount) | (plane[y * 2] << (64 - amount));
+                plane[y * 2] >>= amount;
+            }
+        }
+        else
+        {
+            for (int y = 0; y < height; y++)
+            {
+                plane[y * 2] = (plane[y * 2] << amount) | (plane[y * 2 + 1] >> (64 - amount));
+                plane[y * 2 + 1] <<= amount;
+            }
+        }
+    }
+    drawFlag = true;
+}
+
+//00FE/00FF - switching modes clears the whole display, whatever planes are selected
+void CHIP8::SetResolution(bool high)
+{
+    hires = high;
+    for (Plane& plane : planes)
+    {
+        plane.fill(0);
+    }
+    drawFlag = true;
+}
+
+void CHIP8::Skip()
+{
+    pc += (RAM[pc] == 0xF0 && RAM[static_cast<uint16_t>(pc + 1)] == 0x00) ? 4 : 2;
+}
+
+uint8_t CHIP8::PixelColor(int x, int y) const
+{
+    const int word = y * 2 + x / 64;
+    const int bit = 63 - x % 64;
+    return ((planes[0][word] >> bit) & 1) | (((planes[1][word] >> bit) & 1) << 1);
 }
     
 CHIP8::Instruction CHIP8::SKP_Ex9E(uint8_t x)
@@ -571,7 +2015,7 @@ CHIP8::Instruction CHIP8::SKP_Ex9E(uint8_t x)
     {
         if (keyboardState[registers[x]] == 1)
         {
-            pc += 2;
+            Skip();
         }
     };
 }
@@ -582,7 +2026,7 @@ CHIP8::Instruction CHIP8::SKNP_ExA1(uint8_t x)
     {
         if (keyboardState[registers[x]] == 0)
         {
-            pc += 2;
+            Skip();
         }
     };
 }
@@ -599,22 +2043,7 @@ CHIP8::Instruction CHIP8::LD_Fx0A(uint8_t x)
 {
     return [this, x]()
     {
-        uint8_t keyVal = 0;
-        bool keyPressed = false;
-        auto IsZero = [](uint8_t i){ return i == 0; };
-
-        while (keyPressed)
-        {
-            auto pressedKey = std::find_if_not(keyboardState.begin(), keyboardState.end(), IsZero);
-
-            if (pressedKey != keyboardState.end())
-            {
-                keyVal = *pressedKey;
-                keyPressed = true;
-            }
-
-            registers[x] = keyVal;
-        }
+        BeginKeyWait(x);
     };
 }
 
@@ -630,7 +2059,7 @@ CHIP8::Instruction CHIP8::LD_Fx18(uint8_t x)
 {
     return [this, x]()
     {
-        registers[x] = soundTimer;
+        soundTimer = registers[x];
     };
 }
 
@@ -655,8 +2084,9 @@ CHIP8::Instruction CHIP8::LD_Fx33(uint8_t x)
     return [this, x]()
     {
         RAM[index] = registers[x] / 100;
-        RAM[index + 1] = (registers[x] % 100) / 10;
-        RAM[index + 2] = (registers[x] % 100) % 10;
+        RAM[static_cast<uint16_t>(index + 1)] = (registers[x] % 100) / 10;
+        RAM[static_cast<uint16_t>(index + 2)] = (registers[x] % 100) % 10;
+        MarkWritten(index, 3);
     };
 }
 
@@ -666,8 +2096,9 @@ CHIP8::Instruction CHIP8::LD_Fx55(uint8_t x)
     {
         for (uint8_t i = 0; i <= x; i++)
         {
-            RAM[index + i] = registers[i];
+            RAM[static_cast<uint16_t>(index + i)] = registers[i];
         }
+        MarkWritten(index, x + 1);
     };
 }
 
@@ -677,7 +2108,155 @@ CHIP8::Instruction CHIP8::LD_Fx65(uint8_t x)
     {
         for (uint8_t i = 0; i <= x; i++)
         {
-            registers[i] = RAM[index + i];
+            registers[i] = RAM[static_cast<uint16_t>(index + i)];
+        }
+    };
+}
+
+CHIP8::Instruction CHIP8::SCD_00Cn(uint8_t n)
+{
+    return [this, n]()
+    {
+        ScrollVertical(n);
+    };
+}
+
+CHIP8::Instruction CHIP8::SCR_00FB()
+{
+    return [this]()
+    {
+        ScrollHorizontal(4);
+    };
+}
+
+CHIP8::Instruction CHIP8::SCL_00FC()
+{
+    return [this]()
+    {
+        ScrollHorizontal(-4);
+    };
+}
+
+CHIP8::Instruction CHIP8::EXIT_00FD()
+{
+    return [this]()
+    {
+        halted = true;
+    };
+}
+
+CHIP8::Instruction CHIP8::LOW_00FE()
+{
+    return [this]()
+    {
+        SetResolution(false);
+    };
+}
+
+CHIP8::Instruction CHIP8::HIGH_00FF()
+{
+    return [this]()
+    {
+        SetResolution(true);
+    };
+}
+
+CHIP8::Instruction CHIP8::LD_Fx30(uint8_t x)
+{
+    return [this, x]()
+    {
+        index = 0xA0 + (registers[x] & 0xF) * 10;
+    };
+}
+
+CHIP8::Instruction CHIP8::LD_Fx75(uint8_t x)
+{
+    return [this, x]()
+    {
+        for (uint8_t i = 0; i <= x; i++)
+        {
+            flagRegisters[i] = registers[i];
+        }
+    };
+}
+
+CHIP8::Instruction CHIP8::LD_Fx85(uint8_t x)
+{
+    return [this, x]()
+    {
+        for (uint8_t i = 0; i <= x; i++)
+        {
+            registers[i] = flagRegisters[i];
+        }
+    };
+}
+
+CHIP8::Instruction CHIP8::SCU_00Dn(uint8_t n)
+{
+    return [this, n]()
+    {
+        ScrollVertical(-n);
+    };
+}
+
+CHIP8::Instruction CHIP8::LD_5xy2(uint8_t x, uint8_t y)
+{
+    return [this, x, y]()
+    {
+        const int step = x <= y ? 1 : -1;
+        for (int i = 0; i <= std::abs(y - x); i++)
+        {
+            RAM[static_cast<uint16_t>(index + i)] = registers[x + i * step];
+        }
+        MarkWritten(index, std::abs(y - x) + 1);
+    };
+}
+
+CHIP8::Instruction CHIP8::LD_5xy3(uint8_t x, uint8_t y)
+{
+    return [this, x, y]()
+    {
+        const int step = x <= y ? 1 : -1;
+        for (int i = 0; i <= std::abs(y - x); i++)
+        {
+            registers[x + i * step] = RAM[static_cast<uint16_t>(index + i)];
+        }
+    };
+}
+
+//The only 4-byte instruction - pc is already past the F000, so the address is the word at pc
+CHIP8::Instruction CHIP8::LD_F000()
+{
+    return [this]()
+    {
+        index = (RAM[pc] << 8) | RAM[static_cast<uint16_t>(pc + 1)];
+        pc += 2;
+    };
+}
+
+CHIP8::Instruction CHIP8::PLANE_Fn01(uint8_t x)
+{
+    return [this, x]()
+    {
+        planeMask = x & 3;
+    };
+}
+
+CHIP8::Instruction CHIP8::AUDIO_F002()
+{
+    return [this]()
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            audioPattern[i] = RAM[static_cast<uint16_t>(index + i)];
         }
     };
+}
+
+CHIP8::Instruction CHIP8::PITCH_Fx3A(uint8_t x)
+{
+    return [this, x]()
+    {
+        pitch = registers[x];
+    };
 }
\ No newline at end of file
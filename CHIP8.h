@@ -1,23 +1,159 @@
-#include <SDL2/SDL.h>
+#pragma once
+#include "SaveState.h"
+#include "Stats.h"
+#include "Trace.h"
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <string>
 #include <unordered_map>
 #include <vector>
+#include <array>
 #include <functional>
-#include <chrono>
-#include <thread>
+#include <memory>
+
+//Execution cores - OpcodeTable runs each instruction through the prebuilt std::function table,
+//Switch decodes curOpcode by nibble and executes it with a switch over the decoded instruction kind,
+//BlockCache predecodes runs of instructions up to the next branch, fusing common idioms into superinstructions, and
+//executes a whole run per dispatch,
+//Jit compiles those runs to native x86-64 code (see Jit.h) and behaves like BlockCache where that is unavailable
+enum class Core
+{
+    OpcodeTable,
+    Switch,
+    BlockCache,
+    Jit
+};
+
+class Jit;
+class GuestProfiler;
+struct ProgramAnalysis;
+
+//Decoded instruction kinds - one per instruction set function below, plus Invalid for unassigned opcodes
+//The second group are the SUPER-CHIP 1.1 and XO-CHIP extensions. The third are superinstructions Decode never returns -
+//the block cache fuses common idioms into one of these on the first instruction of the sequence (see FuseBlock)
+enum class OpKind : uint8_t
+{
+    Invalid,
+    CLS, RET, JP_1nnn, CALL_2nnn, SE_3xnn, SNE_4xnn, SE_5xy0, LD_6xnn, ADD_7xnn,
+    LD_8xy0, OR_8xy1, AND_8xy2, XOR_8xy3, ADD_8xy4, SUB_8xy5, SHR_8xy6, SUBN_8xy7, SHL_8xyE,
+    SNE_9xy0, LD_Annn, JP_Bnnn, RND_Cxnn, DRW_Dxyn, SKP_Ex9E, SKNP_ExA1,
+    LD_Fx07, LD_Fx0A, LD_Fx15, LD_Fx18, ADD_Fx1E, LD_Fx29, LD_Fx33, LD_Fx55, LD_Fx65,
+    SCD_00Cn, SCU_00Dn, SCR_00FB, SCL_00FC, EXIT_00FD, LOW_00FE, HIGH_00FF, LD_5xy2, LD_5xy3,
+    LD_F000, PLANE_Fn01, AUDIO_F002, LD_Fx30, PITCH_Fx3A, LD_Fx75, LD_Fx85,
+    DRW_6xnn_Annn_Dxyn, DRW_Annn_Dxyn, LD_Annn_Fx65, SE_7xnn_3xnn, SNE_7xnn_4xnn, SE_Fx07_3xnn, SNE_Fx07_4xnn
+};
+
+//An opcode split into its instruction kind and operands
+struct DecodedOp
+{
+    OpKind kind;
+    uint8_t x;
+    uint8_t y;
+    uint8_t n;
+    uint8_t nn;
+    uint16_t nnn;
+};
 
 class CHIP8
 {
 public:
-    //Init with path to ROM file
+    explicit CHIP8(Core core = Core::OpcodeTable);
+    ~CHIP8();
+
+    //Init with path to ROM file - throws std::runtime_error if it cannot be read or does not fit in memory
     void Init(const std::string& ROMPath);
 
+    //Init with a ROM already in memory (eg. a RomImage shared between instances) - throws if it does not fit
+    void Init(const uint8_t* rom, size_t size);
+
     void RunCycle();
 
-    std::vector<uint8_t> display = std::vector<uint8_t>(64 * 32, 0);
+    //Run count instructions - the BlockCache core runs whole blocks per dispatch but never runs more than count
+    //With a profiler attached, stops at each of its sample points to let it sample
+    void RunCycles(int count);
+
+    //Run one 60Hz frame - cyclesPerUpdate instructions, then one delay/sound timer tick
+    void RunFrame();
+
+    //One 60Hz tick of the delay and sound timers
+    void TickTimers();
+
+    //True while an Fx0A is waiting for a key to be pressed and released - RunCycles runs nothing until then,
+    //so frontends can block on their input source instead of running empty frames (the timers still need ticking)
+    bool WaitingForKey() const { return keyWait != KeyWait::None; }
+
+    //True once the ROM has run 00FD (SUPER-CHIP EXIT) - nothing runs after that until the next Init
+    bool Halted() const { return halted; }
+
+    //True if the sound timer was running during the last frame - what the buzzer should be doing until the next tick
+    bool SoundActive() const { return soundActive; }
+
+    //Build the current core's cached code for everything analysis found reachable, instead of on first execution:
+    //opcode table entries for the table core, blocks for the block cache and compiled blocks for the Jit core
+    void Predecode(const ProgramAnalysis& analysis);
+
+    //64-bit FNV-1a hash of the display, for comparing runs without dumping the framebuffer
+    uint64_t DisplayHash() const;
+
+    //Seed the RND_Cxnn generator - each instance has its own, so instances can run on separate threads
+    //Takes effect immediately and again on every Init
+    void Seed(uint32_t seed);
+
+    //Copy the whole machine state into a snapshot, or restore one - LoadState returns false (and leaves the
+    //machine untouched) if the snapshot has the wrong magic or version. Neither allocates.
+    void SaveState(Snapshot& snapshot) const;
+    bool LoadState(const Snapshot& snapshot);
+
+    //Split an opcode into its instruction kind and operands
+    static DecodedOp Decode(uint16_t opcode);
+
+    //Name of an execution core, for reporting
+    static const char* CoreName(Core core);
+
+    //Name of an instruction kind as spelled in OpKind, for reporting
+    static const char* KindName(OpKind kind);
+
+    const Core core;
+
+    //Number of instructions executed since Init
+    uint64_t cycleCount = 0;
+
+    //Where executed instructions are recorded when built with CHIP8_TRACE_LEVEL > 0 (nullptr = not tracing)
+    TraceBuffer* trace = nullptr;
+
+    //Where executions, draws and frames are counted when built with CHIP8_STATS (nullptr = not counting)
+    ExecutionStats* stats = nullptr;
+
+    //Sampling profiler for the guest call stack (nullptr = not profiling)
+    GuestProfiler* profiler = nullptr;
+
+    //Lets a Jit core instance drop back to the block cache (and back again) without being recreated
+    bool jitEnabled = true;
+
+    //Fast-forward loops that provably do nothing until the timers tick or the keys change (see SkipIdleLoop)
+    bool idleSkip = true;
+
+    //RAM pages (256 bytes each) instructions have written to since the owner last cleared this, one bit per page -
+    //lets a lockstep run compare just the RAM that can have changed instead of all 64KB
+    std::array<uint64_t, 4> writtenPages = {};
+
+    //One bit plane of the display - 64 rows of two uint64_t, with pixel x of a row at bit 63 - (x % 64) of word x / 64
+    //Hires (128x64) uses all of it; lores (64x32) only uses the first word of the first 32 rows, so CHIP-8 drawing is
+    //still one word per sprite row. XO-CHIP draws to two planes, everything else only ever touches plane 0.
+    using Plane = std::array<uint64_t, 128>;
+    std::array<Plane, 2> planes = {};
+    bool hires = false;
     bool drawFlag = false;
 
+    //Size of the display in the current mode - 64x32, or 128x64 after 00FF
+    int Width() const { return hires ? 128 : 64; }
+    int Height() const { return hires ? 64 : 32; }
+
+    //Colour of a pixel - bit 0 from plane 0 and bit 1 from plane 1 (so 0 or 1 for anything but XO-CHIP)
+    uint8_t PixelColor(int x, int y) const;
+    bool Pixel(int x, int y) const { return PixelColor(x, y) != 0; }
+
     std::vector<uint8_t> keyboardState = std::vector<uint8_t>(16, 0);
 
     //CPU cycle frequency target in milliseconds - ex. 0.5ms is 2k cycles/second, 1 cycle every 0.0005 seconds
@@ -29,26 +165,182 @@ public:
 
 	uint8_t soundTimer;
 
+    //XO-CHIP audio - the 128-bit sample pattern loaded by F002 and the playback pitch set by Fx3A
+    std::array<uint8_t, 16> audioPattern = {};
+    uint8_t pitch = 64;
+
+    //Whole address space - 4KB for CHIP-8 and SUPER-CHIP, XO-CHIP ROMs can use all 64KB
+    static constexpr size_t memorySize = 0x10000;
+
+    //The whole address space, for analysis and tools
+    const std::array<uint8_t, memorySize>& Memory() const { return RAM; }
+
+    //Address of the next instruction
+    uint16_t PC() const { return pc; }
+
 private:
-    //Load ROM
-    void LoadROM(const std::string& ROMPath);
+    friend class Jit;
+    friend class GuestProfiler;
+    friend class Lockstep;
+
+    using Instruction = std::function<void(void)>;
+
+    //Copy the ROM to 0x200 and clear the rest of program memory - throws std::length_error if it is over maxROMSize
+    void LoadROM(const uint8_t* rom, size_t size);
     
-    //Build the instruction set
-    void BuildOpCodes();
+    //Build the Instruction for one opcode (empty for unassigned opcodes)
+    Instruction BuildOpCode(uint16_t opcode);
 
     //Instruction set done 3 ways: hash table, array, vector
     //std::unordered_map<uint16_t, std::function<void(void)>> opcodeTable;
     //std::function<void(void)> opcodeTable[0xFFFF];
-    std::vector<std::function<void(void)>> opcodeTable = std::vector<std::function<void(void)>>(0xFFFF);
+    //Filled in lazily - RunCycle builds each opcode's entry the first time it executes, in pages of 256 opcodes
+    //allocated on first use, so a new instance only pays for the opcodes its ROM actually runs instead of
+    //building all ~61k up front. Entries only capture this and operands, so they stay valid across Init.
+    using OpcodePage = std::array<std::function<void(void)>, 256>;
+    std::array<std::unique_ptr<OpcodePage>, 256> opcodeTable;
+
+#if CHIP8_TRACE_LEVEL > 0
+    //Record one executed instruction - before is the register file from before it ran
+    void TraceInstruction(uint64_t cycle, uint16_t address, uint16_t opcode, const std::array<uint8_t, 16>& before);
+#endif
+
+#if CHIP8_STATS
+    //Count one instruction of kind executed at address
+    void CountInstruction(uint16_t address, OpKind kind)
+    {
+        if (stats != nullptr)
+        {
+            stats->kinds[static_cast<size_t>(kind)]++;
+            stats->pcs[address]++;
+        }
+    }
+#endif
+
+    //LD_Fx0A for every core - the instruction completes at once and the CPU then stalls in keyWait until a key that
+    //was not already held goes down and comes back up, which loads it into Vx (as on the original interpreter)
+    enum class KeyWait : uint8_t
+    {
+        None,
+        Press,
+        Release
+    };
+    KeyWait keyWait = KeyWait::None;
+    uint8_t keyWaitRegister = 0;
+    uint8_t keyWaitKey = 0;
+    uint16_t keyWaitHeld = 0;
+    void BeginKeyWait(uint8_t x);
+
+    //Advance keyWait from keyboardState - returns true once the wait is over
+    bool UpdateKeyWait();
+
+    //DRW_Dxyn for every core - XORs the sprite at I onto the selected planes and sets VF on collision
+    //n = 0 draws a 16x16 sprite (two bytes per row)
+    void DrawSprite(uint8_t x, uint8_t y, uint8_t n);
+
+    //Display helpers shared by every core - all of them only touch the planes selected by planeMask, except
+    //SetResolution, which clears the whole display
+    void ClearPlanes();
+    void ScrollVertical(int rows);
+    void ScrollHorizontal(int pixels);
+    void SetResolution(bool high);
+
+    //Skip the next instruction - 4 bytes when it is XO-CHIP's F000 nnnn, otherwise 2
+    void Skip();
+
+    //XO-CHIP state - which planes drawing, clearing and scrolling apply to (bit 0 = plane 0), and 00FD's halt
+    uint8_t planeMask = 1;
+    bool halted = false;
+    bool soundActive = false;
+
+    //SUPER-CHIP persistent flag registers for Fx75/Fx85 - kept across Init, like the HP48's RPL flags
+    std::array<uint8_t, 16> flagRegisters = {};
+
+    //True while RunCycles can keep going - false when waiting on Fx0A or halted
+    bool Running() const { return keyWait == KeyWait::None && !halted; }
+
+    //RunCycles for the current core, without stopping for the profiler
+    void RunInstructions(int count);
+
+    //Step up to maxIdleProbe instructions that only touch registers, I and pc, looking for a loop that comes back to
+    //the same pc with the same registers and I. Timers, keys and RAM cannot change before RunCycles returns, so such a
+    //loop repeats exactly until then and every whole period left in count is counted without being run.
+    //Returns the instructions stepped and skipped - fewer than count once the probe finds anything else.
+    int SkipIdleLoop(int count);
+    static constexpr int maxIdlePeriod = 8;
+    static constexpr int maxIdleProbe = 24;
+
+    //Skipped instructions would be missing from traces and stats
+    static constexpr bool skipIdleLoops = CHIP8_TRACE_LEVEL == 0 && !CHIP8_STATS;
+
+    //Run a decoded instruction directly (used by the Switch and BlockCache cores)
+    //A superinstruction runs its whole idiom, reading the operands of the rest of it from the ops that follow op in its
+    //block - pc must already be past all of them
+    void Execute(const DecodedOp& op);
+
+    //Instructions a superinstruction stands for - 1 for everything Decode returns
+    static int FusedLength(OpKind kind);
+
+    //A run of decoded instructions starting at start, ending with the first branch/skip/wait (or at maxBlockLength)
+    struct Block
+    {
+        uint16_t start;
+        uint16_t end;
+        std::vector<DecodedOp> ops;
+    };
+    static constexpr int maxBlockLength = 32;
+
+    //Superinstructions would hide the instructions they cover from per-instruction tracing and stats
+    static constexpr bool fuseBlocks = CHIP8_TRACE_LEVEL == 0 && !CHIP8_STATS;
+
+    //Rewrite the first op of each idiom in ops into its superinstruction - the ops it covers stay behind it for operands
+    static void FuseBlock(std::vector<DecodedOp>& ops);
+
+    //Decode a new block at address, or return nullptr if the first instruction cannot go in a block
+    std::unique_ptr<Block> BuildBlock(uint16_t address);
+
+    //Drop every cached block and all compiled code - for when RAM is replaced wholesale
+    void ResetCodeCaches();
+
+    //Drop every cached block that covers RAM[address] through RAM[address + length - 1] - every core's RAM writes but
+    //the opcode table's come through here, so it marks writtenPages as well
+    void InvalidateCode(uint16_t address, int length);
+
+    //Set the writtenPages bits for RAM[address] through RAM[address + length - 1] (at most 16 bytes, so two pages)
+    void MarkWritten(uint16_t address, int length)
+    {
+        const uint16_t last = static_cast<uint16_t>(address + length - 1);
+        writtenPages[address >> 14] |= uint64_t(1) << ((address >> 8) & 63);
+        writtenPages[last >> 14] |= uint64_t(1) << ((last >> 8) & 63);
+    }
+
+    //Block cache keyed by start address, in pages of 256 addresses allocated on first use (most of the 64KB address
+    //space never holds code), and how many cached blocks cover each byte of RAM
+    using BlockPage = std::array<std::unique_ptr<Block>, 256>;
+    std::array<std::unique_ptr<BlockPage>, 256> blockCache;
+    std::array<uint8_t, memorySize> codeMap = {};
+
+    //Cache slot for a block starting at address - CachedBlock allocates its page, FindBlock returns nullptr instead
+    std::unique_ptr<Block>& CachedBlock(uint16_t address);
+    std::unique_ptr<Block>* FindBlock(uint16_t address);
+
+    //The block RunCycles is executing - if it gets invalidated mid-run it is parked here until the run stops
+    Block* runningBlock = nullptr;
+    std::unique_ptr<Block> retiredBlock;
+    bool blockInvalidated = false;
+
+    //Native code for the Jit core, and the instruction budget generated code counts down
+    std::unique_ptr<Jit> jit;
+    int32_t jitBudget = 0;
 
     uint16_t curOpcode;
     
-    //4kb Memory
-	std::vector<uint8_t> RAM = std::vector<uint8_t>(4096, 0);
-    int maxROMSize = 0xFFF;
+    //64kb Memory
+	std::array<uint8_t, memorySize> RAM = {};
+    static constexpr size_t maxROMSize = memorySize - 0x200;
 
 	//16 one-byte registers
-	std::vector<uint8_t> registers = std::vector<uint8_t>(16, 0x00);
+	std::array<uint8_t, 16> registers = {};
 
 	//Program Counter
 	uint16_t pc;
@@ -57,13 +349,17 @@ private:
 	uint16_t index;
 
 	//Stack of 16-bit addresses
-	std::vector<uint16_t> stack = std::vector<uint16_t>(16, 0x00);
+	std::array<uint16_t, 16> stack = {};
 
 	//Stack pointer
 	uint8_t sp;
 
+    //Per-instance xorshift32 state for RND_Cxnn (replaces the global std::rand)
+    uint32_t rngSeed = 1;
+    uint32_t rngState = 1;
+    uint32_t Random();
+
     //Instruction set functions - abbreviation followed by op # and arguments (eg., 0x1nnn for JP is JP_1nnn)
-    using Instruction = std::function<void(void)>;
     Instruction CLS();
     Instruction RET();
     Instruction JP_1nnn(uint16_t nnn);
@@ -98,4 +394,24 @@ private:
     Instruction LD_Fx33(uint8_t x);
     Instruction LD_Fx55(uint8_t x);
     Instruction LD_Fx65(uint8_t x);
+
+    //SUPER-CHIP 1.1
+    Instruction SCD_00Cn(uint8_t n);
+    Instruction SCR_00FB();
+    Instruction SCL_00FC();
+    Instruction EXIT_00FD();
+    Instruction LOW_00FE();
+    Instruction HIGH_00FF();
+    Instruction LD_Fx30(uint8_t x);
+    Instruction LD_Fx75(uint8_t x);
+    Instruction LD_Fx85(uint8_t x);
+
+    //XO-CHIP
+    Instruction SCU_00Dn(uint8_t n);
+    Instruction LD_5xy2(uint8_t x, uint8_t y);
+    Instruction LD_5xy3(uint8_t x, uint8_t y);
+    Instruction LD_F000();
+    Instruction PLANE_Fn01(uint8_t x);
+    Instruction AUDIO_F002();
+    Instruction PITCH_Fx3A(uint8_t x);
 };
\ No newline at end of file
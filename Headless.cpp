@@ -0,0 +1,196 @@
+#include "Headless.h"
+#include "Analyzer.h"
+#include "InputRecording.h"
+#include "Scheduler.h"
+#include "Seek.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+int RunHeadless(const Options& options)
+{
+    //A replay runs with the seed and instruction rate it was recorded with
+    InputRecording replay;
+    long frames = options.frames;
+    if (!options.replayPath.empty())
+    {
+        replay.Load(options.replayPath);
+        if (frames < 0)
+        {
+            frames = replay.frames;
+        }
+    }
+
+    CHIP8 cpu(options.core);
+    cpu.Seed(options.replayPath.empty() ? options.seed : replay.seed);
+    cpu.idleSkip = options.idleSkip;
+    cpu.Init(options.romPath);
+    if (!LoadStartState(cpu, options))
+    {
+        return 1;
+    }
+    if (options.predecode)
+    {
+        cpu.Predecode(*AnalyzeCached(cpu.Memory()));
+    }
+
+    std::unique_ptr<TraceSession> trace;
+    if (!options.tracePath.empty())
+    {
+        trace = std::make_unique<TraceSession>(options.tracePath);
+        if (!trace->writer.IsOpen())
+        {
+            std::cerr << "Failed to open trace file " << options.tracePath << '\n';
+            return 1;
+        }
+        cpu.trace = &trace->buffer;
+    }
+    std::unique_ptr<ExecutionStats> stats = StartStats(cpu, options);
+    std::unique_ptr<GuestProfiler> profiler = StartProfiler(cpu, options);
+    Scheduler scheduler(options.replayPath.empty() ? options.InstructionRate() : replay.instructionRate, options.unthrottled);
+
+    std::chrono::duration<double> tEmulated(0);
+
+    //A seek runs flat out to its target (with --frames as the most it may take) and the run ends there
+    if (options.seek.Active())
+    {
+        auto tStart = std::chrono::steady_clock::now();
+        SeekResult seek = Seek(cpu, scheduler, options.seek, 0, frames, [&](long frame) { replay.Apply(frame, cpu.keyboardState); });
+        tEmulated = std::chrono::steady_clock::now() - tStart;
+        trace.reset();
+
+        std::cout << "seek: " << seek.Describe() << " after " << seek.frames << " frames, " << cpu.cycleCount << " instructions\n";
+        bool ok = ReportExit(cpu, options, tEmulated);
+        return ok && seek.Reached() ? 0 : 1;
+    }
+
+    for (long frame = 0; frame < frames && !cpu.Halted(); frame++)
+    {
+        replay.Apply(frame, cpu.keyboardState);
+
+        auto tStart = std::chrono::steady_clock::now();
+        scheduler.RunFrame(cpu);
+        tEmulated += std::chrono::steady_clock::now() - tStart;
+
+        if (stats && StatsDumpRequested())
+        {
+            WriteStats(*stats, options.statsPath);
+        }
+
+        scheduler.WaitForFrame();
+    }
+
+    trace.reset();
+
+    return ReportExit(cpu, options, tEmulated) ? 0 : 1;
+}
+
+bool ReportExit(const CHIP8& cpu, const Options& options, std::chrono::duration<double> tEmulated)
+{
+    std::cout << CHIP8::CoreName(options.core) << " core: " << std::dec << cpu.cycleCount << " cycles in " << tEmulated.count() << "s ("
+              << (tEmulated.count() > 0 ? cpu.cycleCount / tEmulated.count() : 0) << " cycles/sec)\n";
+
+    if (options.printHash)
+    {
+        std::cout << "framebuffer hash: " << std::hex << std::setw(16) << std::setfill('0') << cpu.DisplayHash() << std::dec << '\n';
+    }
+
+    bool ok = true;
+    if (!options.dumpPath.empty())
+    {
+        ok = DumpFramebuffer(cpu, options.dumpPath);
+    }
+    if (!options.saveStatePath.empty())
+    {
+        ok = WriteSaveState(cpu, options.saveStatePath) && ok;
+    }
+    if (cpu.stats != nullptr && !options.statsPath.empty())
+    {
+        ok = WriteStats(*cpu.stats, options.statsPath) && ok;
+    }
+    if (cpu.profiler != nullptr && !options.profilePath.empty())
+    {
+        ok = cpu.profiler->Write(options.profilePath) && ok;
+    }
+
+    return ok;
+}
+
+std::unique_ptr<GuestProfiler> StartProfiler(CHIP8& cpu, const Options& options)
+{
+    if (options.profilePath.empty())
+    {
+        return nullptr;
+    }
+
+    auto profiler = std::make_unique<GuestProfiler>(options.profileInterval);
+    if (!options.symbolsPath.empty())
+    {
+        profiler->LoadSymbols(options.symbolsPath);
+    }
+    cpu.profiler = profiler.get();
+    return profiler;
+}
+
+std::unique_ptr<ExecutionStats> StartStats(CHIP8& cpu, const Options& options)
+{
+    if (options.statsPath.empty())
+    {
+        return nullptr;
+    }
+
+    auto stats = std::make_unique<ExecutionStats>();
+    cpu.stats = stats.get();
+    InstallStatsSignal();
+    return stats;
+}
+
+bool LoadStartState(CHIP8& cpu, const Options& options)
+{
+    if (options.loadStatePath.empty())
+    {
+        return true;
+    }
+
+    Snapshot snapshot;
+    if (!ReadSnapshotFile(options.loadStatePath, snapshot))
+    {
+        return false;
+    }
+    if (!cpu.LoadState(snapshot))
+    {
+        std::cerr << options.loadStatePath << " is not a version " << Snapshot::version << " save state\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool WriteSaveState(const CHIP8& cpu, const std::string& path)
+{
+    Snapshot snapshot;
+    cpu.SaveState(snapshot);
+    return WriteSnapshotFile(path, snapshot);
+}
+
+bool DumpFramebuffer(const CHIP8& cpu, const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to open " << path << " for the framebuffer dump\n";
+        return false;
+    }
+
+    const int width = cpu.Width();
+    file << "P1\n" << width << ' ' << cpu.Height() << '\n';
+    for (int y = 0; y < cpu.Height(); y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            file << (cpu.Pixel(x, y) ? '1' : '0') << (x == width - 1 ? '\n' : ' ');
+        }
+    }
+
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "CHIP8.h"
+#include "Options.h"
+#include "Profiler.h"
+#include <chrono>
+#include <memory>
+
+//Run options.romPath for options.frames frames without SDL - returns the process exit code
+//With options.replayPath it plays back that recording instead, for its length unless --frames is given
+//With a seek target it runs to that instead, and fails if it never gets there
+int RunHeadless(const Options& options);
+
+//Restore options.loadStatePath into cpu if one was given - returns false if it could not be read or is not a save state
+bool LoadStartState(CHIP8& cpu, const Options& options);
+
+//Write cpu to path as a save state - returns false if the file could not be written
+bool WriteSaveState(const CHIP8& cpu, const std::string& path);
+
+//Profiler for --profile, attached to cpu with --symbols loaded - nullptr without --profile
+//Throws std::runtime_error if the symbol file cannot be read
+std::unique_ptr<GuestProfiler> StartProfiler(CHIP8& cpu, const Options& options);
+
+//Counters for --stats, attached to cpu and with SIGUSR1 set up to request dumps - nullptr without --stats
+std::unique_ptr<ExecutionStats> StartStats(CHIP8& cpu, const Options& options);
+
+//End-of-run output shared by both frontends: cycles/sec for the core, then the framebuffer hash/dump, save state,
+//stats and profile if requested
+//Returns false if the dump or save state could not be written
+bool ReportExit(const CHIP8& cpu, const Options& options, std::chrono::duration<double> tEmulated);
+
+//Write the display as a plain (P1) PBM image at the current resolution - returns false if the file could not be written
+bool DumpFramebuffer(const CHIP8& cpu, const std::string& path);
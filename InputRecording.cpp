@@ -0,0 +1,131 @@
+#include "InputRecording.h"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+void InputRecording::Record(long frame, const std::vector<uint8_t>& keyboardState)
+{
+    uint16_t keys = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        if (keyboardState[i])
+        {
+            keys |= 1 << i;
+        }
+    }
+
+    if (keys != lastKeys)
+    {
+        events.push_back({ frame, keys });
+        lastKeys = keys;
+    }
+}
+
+void InputRecording::Apply(long frame, std::vector<uint8_t>& keyboardState)
+{
+    while (next < events.size() && events[next].frame <= frame)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            keyboardState[i] = (events[next].keys >> i) & 1;
+        }
+        next++;
+    }
+}
+
+void InputRecording::Save(const std::string& path) const
+{
+    std::vector<uint8_t> bytes;
+    auto put = [&bytes](uint64_t value, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            bytes.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    };
+
+    put(magic, 4);
+    put(version, 2);
+    put(0, 2);
+    put(seed, 4);
+    put(instructionRate, 4);
+    put(frames, 8);
+    put(events.size(), 4);
+
+    long previous = 0;
+    for (const Event& event : events)
+    {
+        uint64_t delta = event.frame - previous;
+        while (delta >= 0x80)
+        {
+            bytes.push_back(static_cast<uint8_t>(delta | 0x80));
+            delta >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(delta));
+        put(event.keys, 2);
+        previous = event.frame;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write input recording " + path);
+    }
+}
+
+void InputRecording::Load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open input recording " + path);
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t at = 0;
+    auto get = [&](int count)
+    {
+        if (at + count > bytes.size())
+        {
+            throw std::runtime_error(path + " is truncated");
+        }
+
+        uint64_t value = 0;
+        for (int i = 0; i < count; i++)
+        {
+            value |= static_cast<uint64_t>(bytes[at++]) << (i * 8);
+        }
+        return value;
+    };
+
+    if (get(4) != magic || get(2) != version)
+    {
+        throw std::runtime_error(path + " is not a version " + std::to_string(version) + " input recording");
+    }
+    get(2);
+    seed = static_cast<uint32_t>(get(4));
+    instructionRate = static_cast<int>(get(4));
+    frames = static_cast<long>(get(8));
+
+    events.clear();
+    next = 0;
+    lastKeys = 0;
+
+    long frame = 0;
+    for (uint64_t count = get(4); count > 0; count--)
+    {
+        uint64_t delta = 0;
+        int shift = 0;
+        uint64_t byte;
+        do
+        {
+            byte = get(1);
+            delta |= (byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        frame += static_cast<long>(delta);
+        events.push_back({ frame, static_cast<uint16_t>(get(2)) });
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//A recorded session - the RND seed and instruction rate it ran with, how many frames it lasted, and every
+//change of the keypad state keyed by the frame it took effect on. Replaying it on the same ROM is bit-identical.
+//Binary format, little-endian:
+//  magic "C8IR", uint16 version, uint16 reserved, uint32 seed, uint32 instructions per second, uint64 frames, uint32 event count
+//  then per event: varint frames since the previous event, uint16 keypad mask (bit n = key n down)
+class InputRecording
+{
+public:
+    static constexpr uint32_t magic = 0x52493843;
+    static constexpr uint16_t version = 2;
+
+    uint32_t seed = 1;
+    int instructionRate = 480;
+    long frames = 0;
+
+    struct Event
+    {
+        long frame;
+        uint16_t keys;
+    };
+    std::vector<Event> events;
+
+    //Note the keypad state at the start of frame - only changes are stored
+    void Record(long frame, const std::vector<uint8_t>& keyboardState);
+
+    //Set keyboardState to what it was at the start of frame - frames must be applied in increasing order
+    void Apply(long frame, std::vector<uint8_t>& keyboardState);
+
+    //Both throw std::runtime_error if the file cannot be written/read or is not a recording
+    void Save(const std::string& path) const;
+    void Load(const std::string& path);
+
+private:
+    uint16_t lastKeys = 0;
+    size_t next = 0;
+};
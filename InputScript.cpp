@@ -0,0 +1,56 @@
+#include "InputScript.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+void InputScript::Load(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open input script " + path);
+    }
+
+    events.clear();
+    next = 0;
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        long frame;
+        int key;
+        int down;
+        if (!(fields >> frame >> std::hex >> key >> std::dec >> down) || frame < 0 || key < 0 || key > 0xF)
+        {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected <frame> <key 0-F> <0|1>");
+        }
+
+        events.push_back({ frame, static_cast<uint8_t>(key), static_cast<uint8_t>(down != 0) });
+    }
+
+    //Stable so events on the same frame keep their file order
+    std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.frame < b.frame; });
+}
+
+void InputScript::Apply(long frame, std::vector<uint8_t>& keyboardState)
+{
+    while (next < events.size() && events[next].frame <= frame)
+    {
+        keyboardState[events[next].key] = events[next].down;
+        next++;
+    }
+}
+
+long InputScript::NextFrame() const
+{
+    return next < events.size() ? events[next].frame : -1;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Scripted keypad input for runs without a keyboard
+//Text format, one event per line: <frame> <key 0-F> <1 = down, 0 = up>; blank lines and lines starting with # are skipped
+class InputScript
+{
+public:
+    //Load events from path - throws std::runtime_error if the file cannot be read or a line does not parse
+    void Load(const std::string& path);
+
+    //Apply every event scheduled for frame to keyboardState - frames must be applied in increasing order
+    void Apply(long frame, std::vector<uint8_t>& keyboardState);
+
+    //Frame of the next event not yet applied, or -1 if there are none left
+    long NextFrame() const;
+
+    struct Event
+    {
+        long frame;
+        uint8_t key;
+        uint8_t down;
+    };
+    std::vector<Event> events;
+
+private:
+    size_t next = 0;
+};
@@ -0,0 +1,499 @@
+#include "Jit.h"
+#include "CHIP8.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define CHIP8_JIT_X64 1
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+    //x86 condition codes, used as 0x70 | cc (rel8) or 0x0F 0x80 | cc (rel32)
+    constexpr uint8_t CC_AE = 0x3;
+    constexpr uint8_t CC_E = 0x4;
+    constexpr uint8_t CC_NE = 0x5;
+    constexpr uint8_t CC_BE = 0x6;
+    constexpr uint8_t CC_L = 0xC;
+
+    //Upper bound on the native code for one block, checked before compiling so a block never runs off the buffer
+    constexpr size_t maxBlockBytes = 4096;
+    constexpr int maxBlockLength = 32;
+
+    bool EndsBlock(OpKind kind)
+    {
+        switch (kind)
+        {
+            case OpKind::JP_1nnn:
+            case OpKind::CALL_2nnn:
+            case OpKind::RET:
+            case OpKind::JP_Bnnn:
+            case OpKind::SE_3xnn:
+            case OpKind::SNE_4xnn:
+            case OpKind::SE_5xy0:
+            case OpKind::SNE_9xy0:
+            case OpKind::SKP_Ex9E:
+            case OpKind::SKNP_ExA1:
+            case OpKind::LD_Fx0A:
+            case OpKind::LD_Fx33:
+            case OpKind::LD_Fx55:
+            case OpKind::EXIT_00FD:
+            case OpKind::LD_5xy2:
+            case OpKind::LD_F000:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool IsSkip(OpKind kind)
+    {
+        switch (kind)
+        {
+            case OpKind::SE_3xnn:
+            case OpKind::SNE_4xnn:
+            case OpKind::SE_5xy0:
+            case OpKind::SNE_9xy0:
+            case OpKind::SKP_Ex9E:
+            case OpKind::SKNP_ExA1:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+Jit::Jit(CHIP8& cpu) : cpu(cpu)
+{
+    auto base = reinterpret_cast<const uint8_t*>(&cpu);
+    registersOffset = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(cpu.registers.data()) - base);
+    indexOffset = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&cpu.index) - base);
+    pcOffset = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&cpu.pc) - base);
+    budgetOffset = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&cpu.jitBudget) - base);
+
+#ifdef CHIP8_JIT_X64
+    void* memory = mmap(nullptr, codeSize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        return;
+    }
+    code = static_cast<uint8_t*>(memory);
+
+    //Trampoline - void(CHIP8* cpu, const uint8_t* block): push rbx; mov rbx, rdi; jmp rsi
+    Emit8(0x53);
+    Emit8(0x48); Emit8(0x89); Emit8(0xFB);
+    Emit8(0xFF); Emit8(0xE6);
+
+    //Shared epilogue every block exits through: pop rbx; ret
+    epilogue = used;
+    Emit8(0x5B);
+    Emit8(0xC3);
+
+    firstBlock = used;
+#endif
+}
+
+Jit::~Jit()
+{
+#ifdef CHIP8_JIT_X64
+    if (code != nullptr)
+    {
+        munmap(code, codeSize);
+    }
+#endif
+}
+
+int Jit::Run(int budget)
+{
+    if (code == nullptr)
+    {
+        return 0;
+    }
+
+    if (flushPending)
+    {
+        Flush();
+    }
+
+    uint16_t pc = cpu.pc;
+
+    if (entries[pc] == 0 && Compile(pc) == 0)
+    {
+        return 0;
+    }
+
+    if (lengths[pc] > budget)
+    {
+        return 0;
+    }
+
+    //Blocks charge their length against jitBudget on entry and bail to the epilogue when it would go negative
+    cpu.jitBudget = budget;
+    using Trampoline = void (*)(CHIP8*, const uint8_t*);
+    reinterpret_cast<Trampoline>(code)(&cpu, code + entries[pc]);
+
+    return budget - cpu.jitBudget;
+}
+
+void Jit::InvalidateCode(uint16_t address, int length)
+{
+    for (int a = address; a < address + length && a < static_cast<int>(CHIP8::memorySize); a++)
+    {
+        if (covered[a])
+        {
+            flushPending = true;
+            return;
+        }
+    }
+}
+
+void Jit::Flush()
+{
+    entries.fill(0);
+    lengths.fill(0);
+    covered.fill(0);
+    pendingChains.clear();
+    used = firstBlock;
+    flushPending = false;
+}
+
+void Jit::Precompile(uint16_t address)
+{
+    if (code == nullptr)
+    {
+        return;
+    }
+
+    if (flushPending)
+    {
+        Flush();
+    }
+
+    if (entries[address] == 0)
+    {
+        Compile(address);
+    }
+}
+
+uint32_t Jit::Compile(uint16_t address)
+{
+    //Decode the whole block first so the prologue can charge its full length against the budget
+    uint16_t opcodes[maxBlockLength];
+    int count = 0;
+    bool terminated = false;
+    uint16_t end = address;
+
+    //Blocks stop short of the last word so their end still fits in a uint16_t - code there is stepped
+    while (count < maxBlockLength && end < CHIP8::memorySize - 2)
+    {
+        uint16_t opcode = (cpu.RAM[end] << 8) | cpu.RAM[end + 1];
+        OpKind kind = CHIP8::Decode(opcode).kind;
+
+        //Invalid opcodes are left to RunCycle so they get reported the same way as the other cores
+        if (kind == OpKind::Invalid)
+        {
+            break;
+        }
+
+        opcodes[count++] = opcode;
+        end += 2;
+
+        if (EndsBlock(kind))
+        {
+            terminated = true;
+            break;
+        }
+    }
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    if (codeSize - used < maxBlockBytes)
+    {
+        Flush();
+    }
+
+    uint32_t start = static_cast<uint32_t>(used);
+
+    //cmp dword [budget], count; jl epilogue; sub dword [budget], count
+    Emit8(0x81); EmitMem(7, budgetOffset); Emit32(count);
+    Emit8(0x0F); Emit8(0x80 | CC_L); EmitRel32(epilogue);
+    Emit8(0x81); EmitMem(5, budgetOffset); Emit32(count);
+
+    for (int i = 0; i < count; i++)
+    {
+        CompileOp(opcodes[i], address + (i + 1) * 2);
+    }
+
+    //Blocks cut short by length or an invalid opcode fall through to the next address
+    if (!terminated)
+    {
+        EmitExit(end);
+    }
+
+    //A skip's distance depends on the word after it (F000 nnnn is skipped whole), so cover that word too
+    int coveredEnd = end;
+    if (terminated && IsSkip(CHIP8::Decode(opcodes[count - 1]).kind))
+    {
+        coveredEnd = std::min<int>(end + 2, CHIP8::memorySize);
+    }
+    for (int a = address; a < coveredEnd; a++)
+    {
+        covered[a] = 1;
+    }
+    entries[address] = start;
+    lengths[address] = count;
+
+    //Chain every exit that was waiting for this address (including this block's own back edge)
+    auto chained = std::remove_if(pendingChains.begin(), pendingChains.end(), [&](const ChainSlot& slot)
+    {
+        if (slot.target != address)
+        {
+            return false;
+        }
+        PatchRel32(slot.rel32, start);
+        return true;
+    });
+    pendingChains.erase(chained, pendingChains.end());
+
+    return start;
+}
+
+void Jit::CompileOp(uint16_t opcode, uint16_t nextPC)
+{
+    DecodedOp op = CHIP8::Decode(opcode);
+    const int32_t vx = registersOffset + op.x;
+    const int32_t vy = registersOffset + op.y;
+    const int32_t vf = registersOffset + 0xF;
+
+    //ALU ops that read or write VF as an operand depend on the exact order VF gets cleared/set - leave those to the interpreter
+    const bool usesVF = op.x == 0xF || op.y == 0xF;
+
+    switch (op.kind)
+    {
+        case OpKind::LD_6xnn:
+            //mov byte [Vx], nn
+            Emit8(0xC6); EmitMem(0, vx); Emit8(op.nn);
+            return;
+        case OpKind::ADD_7xnn:
+            //add byte [Vx], nn
+            Emit8(0x80); EmitMem(0, vx); Emit8(op.nn);
+            return;
+        case OpKind::LD_8xy0:
+        case OpKind::OR_8xy1:
+        case OpKind::AND_8xy2:
+        case OpKind::XOR_8xy3:
+        {
+            //movzx eax, byte [Vy]; mov/or/and/xor byte [Vx], al
+            static const uint8_t aluOps[] = { 0x88, 0x08, 0x20, 0x30 };
+            Emit8(0x0F); Emit8(0xB6); EmitMem(0, vy);
+            Emit8(aluOps[op.n]); EmitMem(0, vx);
+            return;
+        }
+        case OpKind::ADD_8xy4:
+            if (usesVF) break;
+            //mov byte [VF], 0; movzx eax, byte [Vy]; add byte [Vx], al; VF = carry
+            Emit8(0xC6); EmitMem(0, vf); Emit8(0);
+            Emit8(0x0F); Emit8(0xB6); EmitMem(0, vy);
+            Emit8(0x00); EmitMem(0, vx);
+            EmitSetVFIfFlag(CC_AE);
+            return;
+        case OpKind::SUB_8xy5:
+            if (usesVF) break;
+            //mov byte [VF], 0; movzx eax, byte [Vy]; sub byte [Vx], al; VF = Vx > Vy
+            Emit8(0xC6); EmitMem(0, vf); Emit8(0);
+            Emit8(0x0F); Emit8(0xB6); EmitMem(0, vy);
+            Emit8(0x28); EmitMem(0, vx);
+            EmitSetVFIfFlag(CC_BE);
+            return;
+        case OpKind::SHR_8xy6:
+        case OpKind::SHL_8xyE:
+            if (op.x == 0xF) break;
+            //mov byte [VF], 0; shr/shl byte [Vx], 1; VF = bit shifted out
+            Emit8(0xC6); EmitMem(0, vf); Emit8(0);
+            Emit8(0xD0); EmitMem(op.kind == OpKind::SHR_8xy6 ? 5 : 4, vx);
+            EmitSetVFIfFlag(CC_AE);
+            return;
+        case OpKind::SUBN_8xy7:
+            if (usesVF) break;
+            //movzx eax, byte [Vy]; mov byte [VF], 0; sub al, byte [Vx]; mov byte [Vx], al; VF = Vy > Vx
+            Emit8(0x0F); Emit8(0xB6); EmitMem(0, vy);
+            Emit8(0xC6); EmitMem(0, vf); Emit8(0);
+            Emit8(0x2A); EmitMem(0, vx);
+            Emit8(0x88); EmitMem(0, vx);
+            EmitSetVFIfFlag(CC_BE);
+            return;
+        case OpKind::LD_Annn:
+            //mov word [index], nnn
+            Emit8(0x66); Emit8(0xC7); EmitMem(0, indexOffset); Emit16(op.nnn);
+            return;
+        case OpKind::ADD_Fx1E:
+            //movzx eax, byte [Vx]; add word [index], ax
+            Emit8(0x0F); Emit8(0xB6); EmitMem(0, vx);
+            Emit8(0x66); Emit8(0x01); EmitMem(0, indexOffset);
+            return;
+        case OpKind::LD_Fx29:
+            //movzx eax, byte [Vx]; imul eax, eax, 5; add eax, 0x50; mov word [index], ax
+            Emit8(0x0F); Emit8(0xB6); EmitMem(0, vx);
+            Emit8(0x6B); Emit8(0xC0); Emit8(5);
+            Emit8(0x05); Emit32(0x50);
+            Emit8(0x66); Emit8(0x89); EmitMem(0, indexOffset);
+            return;
+        case OpKind::JP_1nnn:
+            EmitExit(op.nnn);
+            return;
+        case OpKind::CALL_2nnn:
+            EmitCall(opcode, nextPC);
+            EmitExit(op.nnn);
+            return;
+        case OpKind::SE_3xnn:
+        case OpKind::SNE_4xnn:
+            //cmp byte [Vx], nn
+            Emit8(0x80); EmitMem(7, vx); Emit8(op.nn);
+            EmitSkip(op.kind == OpKind::SE_3xnn ? CC_NE : CC_E, nextPC, SkipTarget(nextPC));
+            return;
+        case OpKind::SE_5xy0:
+        case OpKind::SNE_9xy0:
+            //movzx eax, byte [Vy]; cmp byte [Vx], al
+            Emit8(0x0F); Emit8(0xB6); EmitMem(0, vy);
+            Emit8(0x38); EmitMem(0, vx);
+            EmitSkip(op.kind == OpKind::SE_5xy0 ? CC_NE : CC_E, nextPC, SkipTarget(nextPC));
+            return;
+        case OpKind::RET:
+        case OpKind::JP_Bnnn:
+        case OpKind::SKP_Ex9E:
+        case OpKind::SKNP_ExA1:
+        case OpKind::LD_Fx0A:
+        case OpKind::LD_F000:
+            //pc is only known at run time
+            EmitCall(opcode, nextPC);
+            EmitDynamicExit();
+            return;
+        case OpKind::EXIT_00FD:
+            //Back to RunCycles, which stops once halted
+            EmitCall(opcode, nextPC);
+            EmitDynamicExit();
+            return;
+        case OpKind::LD_Fx33:
+        case OpKind::LD_Fx55:
+        case OpKind::LD_5xy2:
+            //The write may have hit compiled code (possibly this block), so never chain out of these
+            EmitCall(opcode, nextPC);
+            EmitDynamicExit();
+            return;
+        default:
+            break;
+    }
+
+    //Everything else (CLS, RND, DRW, timers, Fx65, and the VF-operand ALU cases) runs in the interpreter
+    EmitCall(opcode, nextPC);
+}
+
+uint16_t Jit::SkipTarget(uint16_t nextPC) const
+{
+    const bool longInstruction = cpu.RAM[nextPC] == 0xF0 && cpu.RAM[static_cast<uint16_t>(nextPC + 1)] == 0x00;
+    return nextPC + (longInstruction ? 4 : 2);
+}
+
+void Jit::Fallback(CHIP8* cpu, uint32_t arg)
+{
+    cpu->pc = arg >> 16;
+    cpu->curOpcode = arg & 0xFFFF;
+    cpu->Execute(CHIP8::Decode(cpu->curOpcode));
+}
+
+void Jit::Emit8(uint8_t value)
+{
+    code[used++] = value;
+}
+
+void Jit::Emit16(uint16_t value)
+{
+    std::memcpy(code + used, &value, sizeof(value));
+    used += sizeof(value);
+}
+
+void Jit::Emit32(uint32_t value)
+{
+    std::memcpy(code + used, &value, sizeof(value));
+    used += sizeof(value);
+}
+
+void Jit::Emit64(uint64_t value)
+{
+    std::memcpy(code + used, &value, sizeof(value));
+    used += sizeof(value);
+}
+
+void Jit::EmitMem(uint8_t reg, int32_t disp)
+{
+    //ModRM mod=10 (disp32), rm=011 (rbx)
+    Emit8(0x80 | (reg << 3) | 0x3);
+    Emit32(static_cast<uint32_t>(disp));
+}
+
+void Jit::EmitRel32(size_t target)
+{
+    Emit32(static_cast<uint32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(used + 4)));
+}
+
+void Jit::PatchRel32(size_t at, size_t target)
+{
+    uint32_t rel = static_cast<uint32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+    std::memcpy(code + at, &rel, sizeof(rel));
+}
+
+void Jit::EmitCall(uint16_t opcode, uint16_t nextPC)
+{
+    //mov rdi, rbx; mov esi, (nextPC << 16) | opcode; mov rax, Fallback; call rax
+    Emit8(0x48); Emit8(0x89); Emit8(0xDF);
+    Emit8(0xBE); Emit32((static_cast<uint32_t>(nextPC) << 16) | opcode);
+    Emit8(0x48); Emit8(0xB8); Emit64(reinterpret_cast<uint64_t>(&Jit::Fallback));
+    Emit8(0xFF); Emit8(0xD0);
+}
+
+void Jit::EmitExit(uint16_t target)
+{
+    //mov word [pc], target; jmp target block (or the epilogue until target is compiled)
+    Emit8(0x66); Emit8(0xC7); EmitMem(0, pcOffset); Emit16(target);
+    Emit8(0xE9);
+
+    if (entries[target] != 0)
+    {
+        EmitRel32(entries[target]);
+    }
+    else
+    {
+        pendingChains.push_back({ static_cast<uint32_t>(used), target });
+        EmitRel32(epilogue);
+    }
+}
+
+void Jit::EmitDynamicExit()
+{
+    //jmp epilogue - pc was already set by the interpreter
+    Emit8(0xE9);
+    EmitRel32(epilogue);
+}
+
+void Jit::EmitSetVFIfFlag(uint8_t jccSkip)
+{
+    //j<cc> over the 7-byte mov byte [VF], 1
+    Emit8(0x70 | jccSkip);
+    Emit8(7);
+    Emit8(0xC6); EmitMem(0, registersOffset + 0xF); Emit8(1);
+}
+
+void Jit::EmitSkip(uint8_t jccNotTaken, uint16_t nextPC, uint16_t skipTo)
+{
+    //j<cc> notTaken; exit to skipTo (skip taken); notTaken: exit to nextPC
+    Emit8(0x0F); Emit8(0x80 | jccNotTaken);
+    size_t notTaken = used;
+    Emit32(0);
+    EmitExit(skipTo);
+    PatchRel32(notTaken, used);
+    EmitExit(nextPC);
+}
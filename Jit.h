@@ -0,0 +1,90 @@
+#pragma once
+#include "CHIP8.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//x86-64 dynamic recompiler for the Jit core
+//Translates blocks of CHIP-8 instructions into native code in an mmap'd executable buffer. The generated code keeps
+//the CHIP8 object in rbx and works directly on its registers/index/pc members; DRW, keyboard, timer, RND, stack and
+//memory ops are handed back to the interpreter through Fallback(). Blocks jump straight into each other once their
+//targets are compiled (chaining), and any Fx33/Fx55/5xy2 write into compiled code flushes the whole buffer.
+class Jit
+{
+public:
+    explicit Jit(CHIP8& cpu);
+    ~Jit();
+
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    //False if this host cannot run generated code (not x86-64, or no executable memory) - the CHIP8 then runs without it
+    bool Available() const { return code != nullptr; }
+
+    //Run compiled code from cpu.pc for at most budget instructions and return how many ran
+    //Returns 0 if the block at pc could not be compiled or does not fit in the budget - the caller steps it instead
+    int Run(int budget);
+
+    //Called for every interpreter write to RAM - writes into compiled code flush the buffer before the next Run
+    void InvalidateCode(uint16_t address, int length);
+
+    //Compile the block at address ahead of time, if it is not already compiled
+    void Precompile(uint16_t address);
+
+private:
+    CHIP8& cpu;
+
+    uint8_t* code = nullptr;
+    size_t used = 0;
+    static constexpr size_t codeSize = 1 << 20;
+
+    //Offsets of the shared epilogue and of each compiled block's entry (0 = not compiled), plus each block's length
+    size_t epilogue = 0;
+    size_t firstBlock = 0;
+    std::array<uint32_t, CHIP8::memorySize> entries = {};
+    std::array<uint8_t, CHIP8::memorySize> lengths = {};
+
+    //Which RAM bytes are covered by compiled code (including the word after a skip, which decides how far it jumps),
+    //and whether a write has hit any of them
+    std::array<uint8_t, CHIP8::memorySize> covered = {};
+    bool flushPending = false;
+
+    //Exit jumps still pointing at the epilogue, waiting for their target address to be compiled
+    struct ChainSlot
+    {
+        uint32_t rel32;
+        uint16_t target;
+    };
+    std::vector<ChainSlot> pendingChains;
+
+    //Offsets of CHIP8 members relative to the object, used as [rbx + disp32] operands
+    int32_t registersOffset;
+    int32_t indexOffset;
+    int32_t pcOffset;
+    int32_t budgetOffset;
+
+    void Flush();
+    uint32_t Compile(uint16_t address);
+    void CompileOp(uint16_t opcode, uint16_t nextPC);
+
+    //Where a taken skip at nextPC - 2 lands - past the whole of an F000 nnnn
+    uint16_t SkipTarget(uint16_t nextPC) const;
+
+    //Interpreter fallback called from generated code - arg is (pc after the instruction << 16) | opcode
+    static void Fallback(CHIP8* cpu, uint32_t arg);
+
+    //Encoding helpers - every memory operand is [rbx + disp32]
+    void Emit8(uint8_t value);
+    void Emit16(uint16_t value);
+    void Emit32(uint32_t value);
+    void Emit64(uint64_t value);
+    void EmitMem(uint8_t reg, int32_t disp);
+    void EmitRel32(size_t target);
+    void PatchRel32(size_t at, size_t target);
+    void EmitCall(uint16_t opcode, uint16_t nextPC);
+    void EmitExit(uint16_t target);
+    void EmitDynamicExit();
+    void EmitSetVFIfFlag(uint8_t jccSkip);
+    void EmitSkip(uint8_t jccNotTaken, uint16_t nextPC, uint16_t skipTo);
+};
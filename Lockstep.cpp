@@ -0,0 +1,315 @@
+#include "Lockstep.h"
+#include "Analyzer.h"
+#include "Headless.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+//A replay runs with the seed and instruction rate it was recorded with, as in RunHeadless
+static InputRecording LoadReplay(const std::string& path)
+{
+    InputRecording replay;
+    if (!path.empty())
+    {
+        replay.Load(path);
+    }
+    return replay;
+}
+
+//64-bit FNV-1a over all of RAM, like DisplayHash
+static uint64_t MemoryHash(const std::array<uint8_t, CHIP8::memorySize>& memory)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint8_t byte : memory)
+    {
+        hash = (hash ^ byte) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static void PrintField(const std::string& name, uint64_t a, uint64_t b)
+{
+    if (a != b)
+    {
+        std::cout << "  " << std::left << std::setw(14) << name << std::right << std::hex << a << " / " << b << std::dec << '\n';
+    }
+}
+
+Lockstep::Lockstep(const Options& options)
+    : options(options), replay(LoadReplay(options.replayPath)), reference(options.core), candidate(options.lockstepCore),
+      scheduler(options.replayPath.empty() ? options.InstructionRate() : replay.instructionRate, true),
+      frames(options.frames >= 0 || options.replayPath.empty() ? options.frames : replay.frames)
+{
+    for (CHIP8* cpu : { &reference, &candidate })
+    {
+        cpu->Seed(options.replayPath.empty() ? options.seed : replay.seed);
+        cpu->idleSkip = options.idleSkip;
+        cpu->Init(options.romPath);
+        if (!LoadStartState(*cpu, options))
+        {
+            throw std::runtime_error("cannot load " + options.loadStatePath);
+        }
+        if (options.predecode)
+        {
+            cpu->Predecode(*AnalyzeCached(cpu->Memory()));
+        }
+    }
+}
+
+bool Lockstep::Run()
+{
+    const char* referenceName = CHIP8::CoreName(reference.core);
+    const char* candidateName = CHIP8::CoreName(candidate.core);
+
+    //Init and the start state write RAM wholesale without marking it - check all of it once up front
+    reference.writtenPages.fill(~uint64_t(0));
+    if (!Same(reference, candidate, true))
+    {
+        std::cout << "lockstep: " << referenceName << " and " << candidateName << " differ before the first instruction\n";
+        PrintDifferences();
+        return false;
+    }
+
+    long frame = 0;
+    for (; frame < frames && !reference.Halted(); frame++)
+    {
+        if (frame % checkpointFrames == 0)
+        {
+            SaveCheckpoint(frame);
+        }
+
+        if (!RunFrame(frame, options.lockstepChunk, false))
+        {
+            std::cout << "lockstep: " << referenceName << " and " << candidateName << " diverge in frame " << frame
+                      << ", by instruction " << reference.cycleCount << "\n";
+            PrintDifferences();
+
+            const long from = checkpoint.frame;
+            if (Narrow(frame))
+            {
+                std::cout << "stepping from frame " << from << ", they first differ after instruction " << reference.cycleCount << ":\n";
+                PrintTrail();
+                PrintDifferences();
+            }
+            else
+            {
+                std::cout << "stepping one instruction at a time from frame " << from << " does not reproduce it - it only shows "
+                          << "when each core runs " << options.lockstepChunk << " instructions at a time\n";
+            }
+            return false;
+        }
+    }
+
+    //RAM pages nobody marked as written cannot differ, unless a core writes RAM behind the tracking - look at all of it
+    reference.writtenPages.fill(~uint64_t(0));
+    comparisons++;
+    if (!Same(reference, candidate, true) || reference.DisplayHash() != candidate.DisplayHash())
+    {
+        std::cout << "lockstep: " << referenceName << " and " << candidateName << " differ at the end of the run\n";
+        PrintDifferences();
+        return false;
+    }
+
+    std::cout << "lockstep: " << referenceName << " and " << candidateName << " agree over " << frame << " frames, "
+              << reference.cycleCount << " instructions, " << comparisons << " comparisons\n";
+    return true;
+}
+
+void Lockstep::SaveCheckpoint(long frame)
+{
+    checkpoint.frame = frame;
+    reference.SaveState(checkpoint.state);
+    checkpoint.scheduler = scheduler;
+    checkpoint.replay = replay;
+    checkpoint.keys = reference.keyboardState;
+}
+
+void Lockstep::RestoreCheckpoint()
+{
+    for (CHIP8* cpu : { &reference, &candidate })
+    {
+        cpu->LoadState(checkpoint.state);
+        cpu->keyboardState = checkpoint.keys;
+        cpu->writtenPages = {};
+        cpu->drawFlag = false;
+    }
+    scheduler = checkpoint.scheduler;
+    replay = checkpoint.replay;
+}
+
+bool Lockstep::RunFrame(long frame, int chunk, bool record)
+{
+    replay.Apply(frame, reference.keyboardState);
+    candidate.keyboardState = reference.keyboardState;
+
+    int count = scheduler.FrameInstructions();
+    while (count > 0)
+    {
+        const int n = std::min(count, chunk);
+        const uint64_t before = reference.cycleCount;
+        const uint16_t pc = reference.pc;
+
+        reference.RunCycles(n);
+        candidate.RunCycles(n);
+        comparisons++;
+
+        const uint64_t executed = reference.cycleCount - before;
+        if (record && executed > 0)
+        {
+            auto word = [this](uint16_t address) { return static_cast<uint16_t>(reference.RAM[address] << 8 | reference.RAM[static_cast<uint16_t>(address + 1)]); };
+            trail[trailLength++ % trail.size()] = { before, pc, word(pc), word(static_cast<uint16_t>(pc + 2)) };
+        }
+
+        if (!Same(reference, candidate, false))
+        {
+            return false;
+        }
+
+        //Stalled on Fx0A or 00FD - the rest of the frame's instructions are lost, as in CHIP8::RunCycles
+        if (executed < static_cast<uint64_t>(n))
+        {
+            break;
+        }
+        count -= n;
+    }
+
+    reference.TickTimers();
+    candidate.TickTimers();
+    comparisons++;
+    return Same(reference, candidate, true);
+}
+
+bool Lockstep::Narrow(long lastFrame)
+{
+    RestoreCheckpoint();
+    trailLength = 0;
+
+    for (long frame = checkpoint.frame; frame <= lastFrame; frame++)
+    {
+        if (!RunFrame(frame, 1, true))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Lockstep::Same(CHIP8& a, CHIP8& b, bool planes)
+{
+    bool same = a.pc == b.pc && a.index == b.index && a.sp == b.sp && a.cycleCount == b.cycleCount
+                && a.registers == b.registers && a.stack == b.stack
+                && a.delayTimer == b.delayTimer && a.soundTimer == b.soundTimer && a.soundActive == b.soundActive
+                && a.keyWait == b.keyWait && a.keyWaitRegister == b.keyWaitRegister && a.keyWaitKey == b.keyWaitKey
+                && a.keyWaitHeld == b.keyWaitHeld && a.halted == b.halted
+                && a.hires == b.hires && a.planeMask == b.planeMask && a.pitch == b.pitch && a.rngState == b.rngState
+                && a.audioPattern == b.audioPattern && a.flagRegisters == b.flagRegisters;
+
+    if (same && (planes || a.drawFlag || b.drawFlag))
+    {
+        same = a.planes == b.planes;
+    }
+
+    for (size_t word = 0; same && word < a.writtenPages.size(); word++)
+    {
+        const uint64_t pages = a.writtenPages[word] | b.writtenPages[word];
+        for (size_t bit = 0; pages != 0 && bit < 64; bit++)
+        {
+            const size_t page = word * 64 + bit;
+            if ((pages >> bit & 1) && std::memcmp(&a.RAM[page * 256], &b.RAM[page * 256], 256) != 0)
+            {
+                same = false;
+                break;
+            }
+        }
+    }
+
+    if (same)
+    {
+        a.writtenPages = {};
+        b.writtenPages = {};
+        a.drawFlag = false;
+        b.drawFlag = false;
+    }
+    return same;
+}
+
+void Lockstep::PrintDifferences() const
+{
+    const CHIP8& a = reference;
+    const CHIP8& b = candidate;
+
+    std::cout << "differences (" << CHIP8::CoreName(a.core) << " / " << CHIP8::CoreName(b.core) << ", hex):\n";
+    PrintField("pc", a.pc, b.pc);
+    PrintField("I", a.index, b.index);
+    PrintField("sp", a.sp, b.sp);
+    PrintField("instructions", a.cycleCount, b.cycleCount);
+    for (int i = 0; i < 16; i++)
+    {
+        std::ostringstream name;
+        name << 'V' << std::hex << std::uppercase << i;
+        PrintField(name.str(), a.registers[i], b.registers[i]);
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        PrintField("stack[" + std::to_string(i) + "]", a.stack[i], b.stack[i]);
+    }
+    PrintField("delay timer", a.delayTimer, b.delayTimer);
+    PrintField("sound timer", a.soundTimer, b.soundTimer);
+    PrintField("sound active", a.soundActive, b.soundActive);
+    PrintField("key wait", static_cast<int>(a.keyWait), static_cast<int>(b.keyWait));
+    PrintField("key wait Vx", a.keyWaitRegister, b.keyWaitRegister);
+    PrintField("key wait key", a.keyWaitKey, b.keyWaitKey);
+    PrintField("keys held", a.keyWaitHeld, b.keyWaitHeld);
+    PrintField("halted", a.halted, b.halted);
+    PrintField("hires", a.hires, b.hires);
+    PrintField("plane mask", a.planeMask, b.planeMask);
+    PrintField("pitch", a.pitch, b.pitch);
+    PrintField("rng state", a.rngState, b.rngState);
+    for (int i = 0; i < 16; i++)
+    {
+        PrintField("pattern[" + std::to_string(i) + "]", a.audioPattern[i], b.audioPattern[i]);
+        PrintField("flags[" + std::to_string(i) + "]", a.flagRegisters[i], b.flagRegisters[i]);
+    }
+
+    size_t differing = 0;
+    size_t first = 0;
+    for (size_t address = 0; address < CHIP8::memorySize; address++)
+    {
+        if (a.RAM[address] != b.RAM[address] && differing++ == 0)
+        {
+            first = address;
+        }
+    }
+    if (differing > 0)
+    {
+        std::cout << "  RAM           " << differing << " bytes differ, the first at " << std::hex << first << " ("
+                  << int(a.RAM[first]) << " / " << int(b.RAM[first]) << ")" << std::dec << '\n';
+    }
+
+    std::cout << std::hex << std::setfill('0')
+              << "  RAM hash      " << std::setw(16) << MemoryHash(a.RAM) << " / " << std::setw(16) << MemoryHash(b.RAM) << '\n'
+              << "  display hash  " << std::setw(16) << a.DisplayHash() << " / " << std::setw(16) << b.DisplayHash() << '\n'
+              << std::dec << std::setfill(' ');
+}
+
+void Lockstep::PrintTrail() const
+{
+    const size_t count = std::min(trailLength, trail.size());
+    for (size_t i = trailLength - count; i < trailLength; i++)
+    {
+        const Step& step = trail[i % trail.size()];
+        std::cout << "  " << std::setw(10) << step.cycle << "  " << std::hex << std::uppercase << std::setfill('0')
+                  << std::setw(4) << step.pc << "  " << std::setw(4) << step.opcode << std::dec << std::nouppercase
+                  << std::setfill(' ') << "  " << Disassemble(step.opcode, step.next) << '\n';
+    }
+}
+
+int RunLockstep(const Options& options)
+{
+    Lockstep lockstep(options);
+    return lockstep.Run() ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "CHIP8.h"
+#include "InputRecording.h"
+#include "Options.h"
+#include "SaveState.h"
+#include "Scheduler.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+//Differential run of one execution core against another - both run the same ROM, seed and input side by side, and
+//are compared after every chunk of at most options.lockstepChunk instructions and after every timer tick:
+//registers, I, pc, sp, the stack, timers, the key wait, display mode and planes, the XO-CHIP audio state, the RNG and
+//every RAM page either one wrote since the last comparison (see CHIP8::writtenPages). All of RAM and the display are
+//compared again at the end.
+//A chunk that disagrees is narrowed down to the instruction - both machines go back to the last checkpoint they
+//agreed at and step one instruction at a time until they differ, and the report lists the instructions leading up
+//to it and every field that differs.
+class Lockstep
+{
+public:
+    //The reference runs options.core and the candidate options.lockstepCore, with options.replayPath's input if given
+    //Throws std::runtime_error if the ROM or the replay cannot be read
+    explicit Lockstep(const Options& options);
+
+    //Run to the end (or 00FD) - returns false at the first divergence, once it has been reported on std::cout
+    bool Run();
+
+private:
+    const Options& options;
+    InputRecording replay;
+    CHIP8 reference;
+    CHIP8 candidate;
+    Scheduler scheduler;
+    long frames;
+    uint64_t comparisons = 0;
+
+    //Where narrowing starts from - taken every checkpointFrames frames while the machines agree
+    struct Checkpoint
+    {
+        long frame = 0;
+        Snapshot state;
+        Scheduler scheduler{0, true};
+        InputRecording replay;
+        std::vector<uint8_t> keys;
+    };
+    Checkpoint checkpoint;
+    static constexpr long checkpointFrames = 60;
+
+    //The last instructions the reference ran while narrowing, oldest first once full
+    struct Step
+    {
+        uint64_t cycle;
+        uint16_t pc;
+        uint16_t opcode;
+        uint16_t next;
+    };
+    std::array<Step, 16> trail = {};
+    size_t trailLength = 0;
+
+    void SaveCheckpoint(long frame);
+    void RestoreCheckpoint();
+
+    //Run one frame on both machines in chunks of at most chunk instructions - false as soon as they differ
+    //With record set, each instruction the reference runs goes in trail (chunk should be 1 then)
+    bool RunFrame(long frame, int chunk, bool record);
+
+    //Step from the checkpoint until they differ, by frame lastFrame at the latest - false if they never do
+    bool Narrow(long lastFrame);
+
+    //Cheap comparison of everything but RAM pages neither side wrote (and the planes, unless something drew or this
+    //is the end of a frame) - clears the written pages and draw flags when they agree
+    static bool Same(CHIP8& a, CHIP8& b, bool planes);
+
+    //Every compared field that differs, then both sides' RAM and display hashes
+    void PrintDifferences() const;
+    void PrintTrail() const;
+};
+
+//Run options.romPath in lockstep on options.core and options.lockstepCore - returns the process exit code
+int RunLockstep(const Options& options);
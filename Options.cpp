@@ -0,0 +1,308 @@
+#include "Options.h"
+#include <iostream>
+
+void PrintUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [options] [rom]\n"
+              << "  --rom <path>         ROM to run (default Roms/IBMLogo.ch8)\n"
+              << "  --core <name>        execution core: table, switch, block or jit (default table, switch for --batch)\n"
+              << "  --ipf <n>            instructions per 60Hz frame (default 8)\n"
+              << "  --rate <hz>          instructions per second, overrides --ipf (eg. 700 for 11.67 per frame)\n"
+              << "  --frames <n>         stop after n frames (required with --headless unless seeking)\n"
+              << "  --until-frame <n>    fast-forward to frame n before showing anything (headless runs stop there)\n"
+              << "  --until-pc <addr>    fast-forward until pc reaches addr (hex with 0x, eg. 0x2a4)\n"
+              << "  --until-hash <hash>  fast-forward until the framebuffer hash, as printed by --hash, equals hash\n"
+              << "  --headless           run without SDL or a window\n"
+              << "  --unthrottled        run frames back to back instead of at 60Hz (also --turbo)\n"
+              << "  --no-idle-skip       run idle loops instruction by instruction instead of skipping to the frame's end\n"
+              << "  --hash               print a hash of the framebuffer at exit\n"
+              << "  --dump <path>        write the framebuffer to path as a PBM image at exit\n"
+              << "  --trace <path>       write an instruction trace (builds with -DCHIP8_TRACE_LEVEL=1 or 2)\n"
+              << "  --stats <path>       write execution stats as JSON at exit and on SIGUSR1 (builds with -DCHIP8_STATS=1)\n"
+              << "  --profile <path>     sample the guest call stack and write flamegraph collapsed stacks at exit\n"
+              << "  --profile-interval <n>  instructions between profile samples (default 1000)\n"
+              << "  --symbols <path>     \"<hex address> <name>\" lines naming subroutines in the profile\n"
+              << "  --disassemble <path> write the ROM's disassembly and basic blocks to path and exit\n"
+              << "  --cfg <path>         write the ROM's control-flow graph to path as Graphviz and exit\n"
+              << "  --predecode          build cached code for everything reachable before running (table, block, jit)\n"
+              << "  --lockstep <core>    run headlessly on --core and this core side by side and report where they diverge\n"
+              << "  --lockstep-chunk <n> instructions between lockstep comparisons (default 32)\n"
+              << "  --seed <n>           seed for RND (default 1)\n"
+              << "  --record <path>      record keypad input to path for --replay\n"
+              << "  --replay <path>      replay a recording headlessly and unthrottled, with its seed and rate\n"
+              << "  --load-state <path>  start from a save state instead of the ROM's first instruction\n"
+              << "  --save-state <path>  write a save state at exit (F5 also writes it in the SDL frontend)\n"
+              << "  --rewind <seconds>   rewind history to keep, 0 to disable (default 300)\n"
+              << "  --library <dir>      index the ROMs in dir and apply their profiles (ipf, keymap)\n"
+              << "  --keymap <keys>      16 keyboard characters for CHIP-8 keys 0-F (default x123qweasdzc4rfv)\n"
+              << "  --batch <path>       run every job in a manifest headlessly and print per-job results\n"
+              << "  --threads <n>        worker threads for --batch (default: one per core)\n"
+              << "  --help               show this text\n";
+}
+
+static bool ParseCore(const std::string& name, Core& core)
+{
+    if (name == "table") core = Core::OpcodeTable;
+    else if (name == "switch") core = Core::Switch;
+    else if (name == "block") core = Core::BlockCache;
+    else if (name == "jit") core = Core::Jit;
+    else return false;
+
+    return true;
+}
+
+bool ParseOptions(int argc, char* args[], Options& options)
+{
+    bool coreGiven = false;
+
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = args[i];
+
+            //Options that take a value read it from the next argument
+            auto value = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::invalid_argument(arg + " needs a value");
+                }
+                return args[++i];
+            };
+
+            if (arg == "--help" || arg == "-h")
+            {
+                PrintUsage(args[0]);
+                return false;
+            }
+            else if (arg == "--rom")
+            {
+                options.romPath = value();
+            }
+            else if (arg == "--core")
+            {
+                std::string name = value();
+                if (!ParseCore(name, options.core))
+                {
+                    throw std::invalid_argument("unknown core " + name);
+                }
+                coreGiven = true;
+            }
+            else if (arg == "--ipf")
+            {
+                options.cyclesPerFrame = std::stoi(value());
+                options.rateGiven = true;
+            }
+            else if (arg == "--rate")
+            {
+                options.instructionRate = std::stoi(value());
+                options.rateGiven = true;
+                if (options.instructionRate < 1)
+                {
+                    throw std::invalid_argument("--rate must be at least 1");
+                }
+            }
+            else if (arg == "--frames")
+            {
+                options.frames = std::stol(value());
+            }
+            else if (arg == "--until-frame")
+            {
+                options.seek.frame = std::stol(value());
+                if (options.seek.frame < 0)
+                {
+                    throw std::invalid_argument("--until-frame must not be negative");
+                }
+            }
+            else if (arg == "--until-pc")
+            {
+                unsigned long pc = std::stoul(value(), nullptr, 0);
+                if (pc >= CHIP8::memorySize)
+                {
+                    throw std::invalid_argument("--until-pc must be below 0x10000");
+                }
+                options.seek.pc = static_cast<int>(pc);
+            }
+            else if (arg == "--until-hash")
+            {
+                options.seek.hash = std::stoull(value(), nullptr, 16);
+                options.seek.hashGiven = true;
+            }
+            else if (arg == "--headless")
+            {
+                options.headless = true;
+            }
+            else if (arg == "--unthrottled" || arg == "--turbo")
+            {
+                options.unthrottled = true;
+            }
+            else if (arg == "--no-idle-skip")
+            {
+                options.idleSkip = false;
+            }
+            else if (arg == "--lockstep")
+            {
+                std::string name = value();
+                if (!ParseCore(name, options.lockstepCore))
+                {
+                    throw std::invalid_argument("unknown core " + name);
+                }
+                options.lockstep = true;
+            }
+            else if (arg == "--lockstep-chunk")
+            {
+                options.lockstepChunk = std::stoi(value());
+                if (options.lockstepChunk < 1)
+                {
+                    throw std::invalid_argument("--lockstep-chunk must be at least 1");
+                }
+            }
+            else if (arg == "--hash")
+            {
+                options.printHash = true;
+            }
+            else if (arg == "--dump")
+            {
+                options.dumpPath = value();
+            }
+            else if (arg == "--trace")
+            {
+                options.tracePath = value();
+                if (CHIP8_TRACE_LEVEL == 0)
+                {
+                    throw std::invalid_argument("--trace needs a build with -DCHIP8_TRACE_LEVEL=1 or 2");
+                }
+            }
+            else if (arg == "--stats")
+            {
+                options.statsPath = value();
+                if (!CHIP8_STATS)
+                {
+                    throw std::invalid_argument("--stats needs a build with -DCHIP8_STATS=1");
+                }
+            }
+            else if (arg == "--profile")
+            {
+                options.profilePath = value();
+            }
+            else if (arg == "--profile-interval")
+            {
+                options.profileInterval = std::stoi(value());
+                if (options.profileInterval < 1)
+                {
+                    throw std::invalid_argument("--profile-interval must be at least 1");
+                }
+            }
+            else if (arg == "--symbols")
+            {
+                options.symbolsPath = value();
+            }
+            else if (arg == "--disassemble")
+            {
+                options.disassemblePath = value();
+            }
+            else if (arg == "--cfg")
+            {
+                options.cfgPath = value();
+            }
+            else if (arg == "--predecode")
+            {
+                options.predecode = true;
+            }
+            else if (arg == "--seed")
+            {
+                options.seed = static_cast<uint32_t>(std::stoul(value(), nullptr, 0));
+            }
+            else if (arg == "--record")
+            {
+                options.recordPath = value();
+            }
+            else if (arg == "--replay")
+            {
+                options.replayPath = value();
+                options.headless = true;
+                options.unthrottled = true;
+            }
+            else if (arg == "--load-state")
+            {
+                options.loadStatePath = value();
+            }
+            else if (arg == "--save-state")
+            {
+                options.saveStatePath = value();
+            }
+            else if (arg == "--rewind")
+            {
+                options.rewindSeconds = std::stoi(value());
+                if (options.rewindSeconds < 0)
+                {
+                    throw std::invalid_argument("--rewind must not be negative");
+                }
+            }
+            else if (arg == "--library")
+            {
+                options.libraryPath = value();
+            }
+            else if (arg == "--keymap")
+            {
+                options.keymap = value();
+                if (options.keymap.size() != 16)
+                {
+                    throw std::invalid_argument("--keymap needs exactly 16 characters");
+                }
+            }
+            else if (arg == "--batch")
+            {
+                options.batchPath = value();
+            }
+            else if (arg == "--threads")
+            {
+                int threads = std::stoi(value());
+                if (threads < 1)
+                {
+                    throw std::invalid_argument("--threads must be at least 1");
+                }
+                options.threads = threads;
+            }
+            else if (arg.size() > 1 && arg[0] == '-')
+            {
+                throw std::invalid_argument("unknown option " + arg);
+            }
+            else
+            {
+                options.romPath = arg;
+            }
+        }
+
+        if (options.cyclesPerFrame < 0)
+        {
+            throw std::invalid_argument("--ipf must not be negative");
+        }
+        //Batch jobs each carry thousands of short-lived instances, so they skip the opcode table unless asked for it
+        if (!options.batchPath.empty() && !coreGiven)
+        {
+            options.core = Core::Switch;
+        }
+        if (options.headless && options.frames < 0 && options.replayPath.empty() && !options.seek.Active())
+        {
+            throw std::invalid_argument("--headless needs --frames");
+        }
+        if (options.lockstep && options.frames < 0 && options.replayPath.empty())
+        {
+            throw std::invalid_argument("--lockstep needs --frames or --replay");
+        }
+        if (options.headless && !options.recordPath.empty())
+        {
+            throw std::invalid_argument("--record records the SDL frontend's keyboard, so it cannot be used headless");
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Bad arguments: " << e.what() << '\n';
+        PrintUsage(args[0]);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "CHIP8.h"
+#include "Seek.h"
+#include <algorithm>
+#include <string>
+#include <thread>
+
+//Command-line settings shared by the SDL and headless frontends
+struct Options
+{
+    std::string romPath = "Roms/IBMLogo.ch8";
+    Core core = Core::OpcodeTable;
+
+    //Instructions per 60Hz frame, or instructions per second if instructionRate is set (see Scheduler.h)
+    int cyclesPerFrame = 8;
+    int instructionRate = 0;
+    int InstructionRate() const { return instructionRate > 0 ? instructionRate : cyclesPerFrame * 60; }
+
+    //Whether --ipf or --rate was given - a ROM library profile only sets the rate when neither was
+    bool rateGiven = false;
+
+    //Stop after this many frames, -1 to run until quit
+    long frames = -1;
+
+    //Fast-forward to a frame, pc or framebuffer hash before anything is shown (see Seek.h) - headless runs stop there
+    SeekTarget seek;
+
+    bool headless = false;
+
+    //Turbo - run frames back to back; timers still tick once per emulated frame
+    bool unthrottled = false;
+
+    //Fast-forward loops that only wait for a timer or key (see CHIP8::SkipIdleLoop) - off to time them as run
+    bool idleSkip = true;
+
+    //Framebuffer output at exit - print its hash, and/or write it to dumpPath as a PBM image
+    bool printHash = false;
+    std::string dumpPath;
+
+    //Write an instruction trace here (needs a build with CHIP8_TRACE_LEVEL > 0)
+    std::string tracePath;
+
+    //Write execution statistics here as JSON at exit and on SIGUSR1 (needs a build with CHIP8_STATS)
+    std::string statsPath;
+
+    //Sample the guest call stack every profileInterval instructions and write collapsed stacks to profilePath at exit,
+    //naming addresses from symbolsPath if given (see Profiler.h)
+    std::string profilePath;
+    int profileInterval = 1000;
+    std::string symbolsPath;
+
+    //Static analysis (see Analyzer.h) - write the ROM's disassembly listing and/or control-flow graph and exit, or
+    //build each run's cached code for everything reachable before it starts
+    std::string disassemblePath;
+    std::string cfgPath;
+    bool predecode = false;
+
+    //Seed for RND_Cxnn - the same seed, ROM and input always give the same run
+    uint32_t seed = 1;
+
+    //Record the SDL session's keypad input to recordPath, or replay a recording headlessly and unthrottled
+    std::string recordPath;
+    std::string replayPath;
+
+    //Restore a save state right after loading the ROM, and/or write one at exit
+    std::string loadStatePath;
+    std::string saveStatePath;
+
+    //Seconds of rewind history the SDL frontend keeps (hold Backspace to rewind), 0 to disable
+    int rewindSeconds = 300;
+
+    //ROM library directory (see RomLibrary.h) - indexed on startup, and its per-ROM profiles applied to the run
+    std::string libraryPath;
+
+    //SDL keys for CHIP-8 keys 0-F, one character each (empty for the default layout)
+    std::string keymap;
+
+    //Run the ROM on core and lockstepCore side by side, comparing them every lockstepChunk instructions, and report
+    //the first instruction they disagree on (see Lockstep.h)
+    bool lockstep = false;
+    Core lockstepCore = Core::Switch;
+    int lockstepChunk = 32;
+
+    //Batch runs - manifest of jobs (see Batch.h) and how many worker threads to spread them over
+    std::string batchPath;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+//Parse argv into options - prints the problem and the usage text and returns false on bad arguments or --help
+bool ParseOptions(int argc, char* args[], Options& options);
+
+void PrintUsage(const char* program);
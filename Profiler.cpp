@@ -0,0 +1,115 @@
+#include "Profiler.h"
+#include "CHIP8.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+static std::string Hex(uint16_t address)
+{
+    std::ostringstream out;
+    out << "0x" << std::hex << std::setw(3) << std::setfill('0') << address;
+    return out.str();
+}
+
+GuestProfiler::GuestProfiler(uint64_t interval) : interval(std::max<uint64_t>(interval, 1)), untilSample(this->interval)
+{
+}
+
+void GuestProfiler::LoadSymbols(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open symbol file " + path);
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream in(line);
+        std::string address;
+        std::string name;
+        if (!(in >> address >> name) || address[0] == '#')
+        {
+            continue;
+        }
+
+        //Collapsed stacks separate frames with ; and the count with a space, so neither can appear in a name
+        std::replace(name.begin(), name.end(), ';', '_');
+        symbols[static_cast<uint16_t>(std::stoul(address, nullptr, 16))] = name;
+    }
+}
+
+int GuestProfiler::UntilSample() const
+{
+    return static_cast<int>(std::min<uint64_t>(untilSample, INT32_MAX));
+}
+
+void GuestProfiler::Advance(uint64_t executed, const CHIP8& cpu)
+{
+    if (executed < untilSample)
+    {
+        untilSample -= executed;
+        return;
+    }
+    untilSample = interval;
+    samples++;
+
+    //stack[1..sp] holds return addresses (CALL increments sp first) - the CALL just before each one says which
+    //subroutine that frame is in
+    scratch.clear();
+    const int depth = std::min<int>(cpu.sp, static_cast<int>(cpu.stack.size()) - 1);
+    for (int i = 1; i <= depth; i++)
+    {
+        const uint16_t call = static_cast<uint16_t>(cpu.stack[i] - 2);
+        const uint16_t opcode = (cpu.RAM[call] << 8) | cpu.RAM[static_cast<uint16_t>(call + 1)];
+        scratch.push_back((opcode & 0xF000) == 0x2000 ? opcode & 0x0FFF : call);
+    }
+    scratch.push_back(cpu.pc);
+    stacks[scratch]++;
+}
+
+std::string GuestProfiler::Name(uint16_t address, bool entry) const
+{
+    auto symbol = symbols.upper_bound(address);
+    if (symbol != symbols.begin())
+    {
+        --symbol;
+        if (symbol->first == address)
+        {
+            return symbol->second;
+        }
+
+        std::ostringstream out;
+        out << symbol->second << "+0x" << std::hex << address - symbol->first;
+        return out.str();
+    }
+
+    return entry ? "sub_" + Hex(address) : Hex(address);
+}
+
+bool GuestProfiler::Write(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to write profile to " << path << '\n';
+        return false;
+    }
+
+    //Everything outside a subroutine is under the program's entry point
+    const std::string root = symbols.count(0x200) ? symbols.at(0x200) : "main";
+    for (const auto& [stack, count] : stacks)
+    {
+        file << root;
+        for (size_t i = 0; i + 1 < stack.size(); i++)
+        {
+            file << ';' << Name(stack[i], true);
+        }
+        file << ';' << Name(stack.back(), false) << ' ' << count << '\n';
+    }
+
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class CHIP8;
+
+//Sampling profiler for the guest program - every interval instructions it records the CHIP-8 call stack and pc
+//Each stack frame is named after the subroutine it is in, found from the 2nnn just before the frame's return
+//address, so no per-CALL bookkeeping is needed and a CHIP8 only pays for the sample itself. Attach it through
+//CHIP8::profiler; RunCycles then stops at each sample point, so every core is sampled at exactly the same instructions.
+class GuestProfiler
+{
+public:
+    explicit GuestProfiler(uint64_t interval);
+
+    //Read symbol names from a side file - one "<hex address> <name>" per line, # starts a comment
+    //Addresses are named by the closest symbol at or below them. Throws std::runtime_error if it cannot be read.
+    void LoadSymbols(const std::string& path);
+
+    //Instructions left before the next sample
+    int UntilSample() const;
+
+    //Count executed instructions, sampling cpu once the next sample is due
+    void Advance(uint64_t executed, const CHIP8& cpu);
+
+    //Write the samples as collapsed stacks for flamegraph tools: "main;sub_0a;sub_0b;pc count" per distinct stack
+    //Returns false if the file could not be written
+    bool Write(const std::string& path) const;
+
+    uint64_t Samples() const { return samples; }
+
+private:
+    const uint64_t interval;
+    uint64_t untilSample;
+    uint64_t samples = 0;
+
+    //Distinct raw stacks (subroutine entry points outermost first, then pc) and how often each was seen
+    std::map<std::vector<uint16_t>, uint64_t> stacks;
+    std::vector<uint16_t> scratch;
+
+    std::map<uint16_t, std::string> symbols;
+
+    //Frame name for a subroutine entry or pc - symbol (plus offset for a pc inside it) or plain address
+    std::string Name(uint16_t address, bool entry) const;
+};
@@ -0,0 +1,350 @@
+#include "RomLibrary.h"
+#include "Options.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_ROM_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+RomImage::RomImage(const std::string& path)
+{
+#ifdef CHIP8_ROM_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open ROM " + path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        close(fd);
+        throw std::runtime_error("ROM " + path + " is not a regular file");
+    }
+    size = static_cast<size_t>(info.st_size);
+
+    if (size > 0)
+    {
+        void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Failed to map ROM " + path);
+        }
+        data = static_cast<const uint8_t*>(address);
+        mapped = true;
+    }
+    close(fd);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open ROM " + path);
+    }
+    copy.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data = copy.data();
+    size = copy.size();
+#endif
+
+    if (size == 0)
+    {
+        throw std::runtime_error("ROM " + path + " is empty");
+    }
+}
+
+RomImage::~RomImage()
+{
+#ifdef CHIP8_ROM_MMAP
+    if (mapped)
+    {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+#endif
+}
+
+uint64_t RomImage::Hash() const
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3;
+    }
+    return hash;
+}
+
+const char* PlatformName(Platform platform)
+{
+    switch (platform)
+    {
+        case Platform::Chip8: return "chip8";
+        case Platform::SuperChip: return "schip";
+        case Platform::XOChip: return "xochip";
+    }
+
+    return "unknown";
+}
+
+static bool ParsePlatform(const std::string& name, Platform& platform)
+{
+    if (name == "chip8") platform = Platform::Chip8;
+    else if (name == "schip") platform = Platform::SuperChip;
+    else if (name == "xochip") platform = Platform::XOChip;
+    else return false;
+
+    return true;
+}
+
+void RomLibrary::Profile(const uint8_t* rom, size_t size, RomInfo& info)
+{
+    //Count the distinct extension opcodes at even offsets - sprite data can look like any one opcode,
+    //so a platform needs two different ones (or an XO-CHIP sized ROM) before it is picked
+    std::set<uint16_t> superChip;
+    std::set<uint16_t> xoChip;
+    for (size_t i = 0; i + 1 < size; i += 2)
+    {
+        uint16_t opcode = (rom[i] << 8) | rom[i + 1];
+        uint8_t nn = opcode & 0xFF;
+
+        if (opcode == 0x00FB || opcode == 0x00FC || opcode == 0x00FD || opcode == 0x00FE || opcode == 0x00FF)
+        {
+            superChip.insert(opcode);
+        }
+        else if ((opcode & 0xFFF0) == 0x00C0 && (opcode & 0xF) != 0)
+        {
+            superChip.insert(0x00C0);
+        }
+        else if ((opcode & 0xF000) == 0xF000 && (nn == 0x30 || nn == 0x75 || nn == 0x85))
+        {
+            superChip.insert(0xF000 | nn);
+        }
+
+        if (opcode == 0xF000 || opcode == 0xF002)
+        {
+            xoChip.insert(opcode);
+        }
+        else if ((opcode & 0xF00F) == 0x5002 || (opcode & 0xF00F) == 0x5003)
+        {
+            xoChip.insert(opcode & 0xF00F);
+        }
+        else if ((opcode & 0xF000) == 0xF000 && (nn == 0x01 || nn == 0x3A))
+        {
+            xoChip.insert(0xF000 | nn);
+        }
+    }
+
+    info.size = size;
+    if (xoChip.size() >= 2 || size > 4096 - 0x200)
+    {
+        info.platform = Platform::XOChip;
+        info.cyclesPerFrame = 1000;
+    }
+    else if (superChip.size() >= 2)
+    {
+        info.platform = Platform::SuperChip;
+        info.cyclesPerFrame = 30;
+    }
+    else
+    {
+        info.platform = Platform::Chip8;
+        info.cyclesPerFrame = 8;
+    }
+}
+
+RomLibrary::RomLibrary(const std::string& directory) : directory(directory)
+{
+    std::ifstream file(std::filesystem::path(directory) / indexName);
+    if (!file)
+    {
+        return;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::vector<std::string> fields;
+        std::string field;
+        std::istringstream stream(line);
+        while (fields.size() < 7 && std::getline(stream, field, '\t'))
+        {
+            fields.push_back(field);
+        }
+        std::getline(stream, field);
+
+        RomInfo info;
+        try
+        {
+            if (fields.size() != 7 || field.empty() || !ParsePlatform(fields[3], info.platform))
+            {
+                throw std::invalid_argument("bad line");
+            }
+            info.hash = std::stoull(fields[0], nullptr, 16);
+            info.size = std::stoull(fields[1]);
+            info.modified = std::stoll(fields[2]);
+            info.cyclesPerFrame = std::stoi(fields[4]);
+            info.keymap = fields[5] == "-" ? "" : fields[5];
+            info.quirks = fields[6] == "-" ? "" : fields[6];
+            info.path = field;
+        }
+        catch (const std::exception&)
+        {
+            throw std::runtime_error(directory + "/" + indexName + ":" + std::to_string(lineNumber) + ": malformed index line");
+        }
+
+        entries.push_back(info);
+    }
+
+    Rehash();
+}
+
+void RomLibrary::Scan()
+{
+    namespace fs = std::filesystem;
+
+    std::unordered_map<std::string, RomInfo> previous;
+    for (RomInfo& info : entries)
+    {
+        previous[info.path] = std::move(info);
+    }
+    std::unordered_map<uint64_t, const RomInfo*> previousByHash;
+    for (const auto& entry : previous)
+    {
+        previousByHash[entry.second.hash] = &entry.second;
+    }
+
+    std::vector<RomInfo> scanned;
+    for (const auto& file : fs::recursive_directory_iterator(directory, fs::directory_options::skip_permission_denied))
+    {
+        std::string extension = file.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (!file.is_regular_file() || (extension != ".ch8" && extension != ".sc8" && extension != ".xo8"))
+        {
+            continue;
+        }
+
+        std::string path = fs::relative(file.path(), directory).generic_string();
+        size_t size = static_cast<size_t>(file.file_size());
+        int64_t modified = file.last_write_time().time_since_epoch().count();
+
+        //Unchanged since the last scan - keep the entry without reading the file
+        auto known = previous.find(path);
+        if (known != previous.end() && known->second.size == size && known->second.modified == modified)
+        {
+            scanned.push_back(known->second);
+            continue;
+        }
+
+        RomInfo info;
+        try
+        {
+            RomImage image(file.path().string());
+            info.hash = image.Hash();
+            Profile(image.Data(), image.Size(), info);
+        }
+        catch (const std::exception&)
+        {
+            continue;
+        }
+        info.path = path;
+        info.modified = modified;
+
+        //Same contents as a ROM already indexed (touched, renamed or copied) - keep its tuning
+        auto same = previousByHash.find(info.hash);
+        if (same != previousByHash.end())
+        {
+            info.platform = same->second->platform;
+            info.cyclesPerFrame = same->second->cyclesPerFrame;
+            info.keymap = same->second->keymap;
+            info.quirks = same->second->quirks;
+        }
+
+        scanned.push_back(std::move(info));
+    }
+
+    std::sort(scanned.begin(), scanned.end(), [](const RomInfo& a, const RomInfo& b) { return a.path < b.path; });
+    entries = std::move(scanned);
+    Rehash();
+    Save();
+}
+
+void RomLibrary::Save() const
+{
+    auto path = std::filesystem::path(directory) / indexName;
+    std::ofstream file(path);
+    file << "#hash\tsize\tmodified\tplatform\tipf\tkeymap\tquirks\tpath\n";
+    for (const RomInfo& info : entries)
+    {
+        file << std::hex << std::setw(16) << std::setfill('0') << info.hash << std::dec << std::setfill(' ') << '\t'
+             << info.size << '\t' << info.modified << '\t' << PlatformName(info.platform) << '\t' << info.cyclesPerFrame << '\t'
+             << (info.keymap.empty() ? "-" : info.keymap) << '\t' << (info.quirks.empty() ? "-" : info.quirks) << '\t'
+             << info.path << '\n';
+    }
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write ROM index " + path.string());
+    }
+}
+
+const RomInfo* RomLibrary::Find(uint64_t hash) const
+{
+    auto found = byHash.find(hash);
+    return found != byHash.end() ? &entries[found->second] : nullptr;
+}
+
+const RomInfo* RomLibrary::FindFile(const std::string& romPath) const
+{
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    fs::path relative = fs::relative(fs::weakly_canonical(romPath, error), fs::weakly_canonical(directory, error), error);
+    if (error)
+    {
+        return nullptr;
+    }
+
+    auto found = byPath.find(relative.generic_string());
+    return found != byPath.end() ? &entries[found->second] : nullptr;
+}
+
+void RomLibrary::Rehash()
+{
+    byHash.clear();
+    byPath.clear();
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        byHash.emplace(entries[i].hash, i);
+        byPath.emplace(entries[i].path, i);
+    }
+}
+
+void ApplyRomProfile(const RomInfo& info, Options& options)
+{
+    if (!options.rateGiven)
+    {
+        options.cyclesPerFrame = info.cyclesPerFrame;
+    }
+    if (options.keymap.empty())
+    {
+        options.keymap = info.keymap;
+    }
+}
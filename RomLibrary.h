@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Options;
+
+//A ROM file mapped read-only in one mmap (read into memory on hosts without mmap)
+//Throws std::runtime_error if the file cannot be opened or mapped, or is empty
+class RomImage
+{
+public:
+    explicit RomImage(const std::string& path);
+    ~RomImage();
+
+    RomImage(const RomImage&) = delete;
+    RomImage& operator=(const RomImage&) = delete;
+
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+    //64-bit FNV-1a of the contents - the key ROMs are indexed by
+    uint64_t Hash() const;
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::vector<uint8_t> copy;
+    bool mapped = false;
+};
+
+enum class Platform
+{
+    Chip8,
+    SuperChip,
+    XOChip
+};
+
+const char* PlatformName(Platform platform);
+
+//What the library knows about one ROM
+//cyclesPerFrame and keymap are applied to runs of the ROM unless given on the command line; quirks is a free-form,
+//comma-separated list kept for frontends and tools (the interpreter itself has no quirk switches to set yet)
+struct RomInfo
+{
+    std::string path;
+    uint64_t hash = 0;
+    size_t size = 0;
+    int64_t modified = 0;
+    Platform platform = Platform::Chip8;
+    int cyclesPerFrame = 8;
+    std::string keymap;
+    std::string quirks;
+};
+
+//Directory of ROMs with an on-disk index (RomLibrary::indexName in the directory, tab-separated, one ROM per line):
+//  <hash> <size> <modified> <platform> <ipf> <keymap or -> <quirks or -> <path>
+//Scan only hashes files whose size or modification time changed since the index was written, and keeps edited
+//ipf/keymap/quirks fields for any ROM whose contents did not change
+class RomLibrary
+{
+public:
+    static constexpr const char* indexName = "chip8-index.tsv";
+
+    //Load the index in directory, if there is one - throws std::runtime_error if it is malformed
+    explicit RomLibrary(const std::string& directory);
+
+    //Bring the index up to date with the .ch8/.sc8/.xo8 files under the directory, then write it back
+    void Scan();
+    void Save() const;
+
+    //Entry for a ROM's contents, or nullptr if the library has not seen them
+    const RomInfo* Find(uint64_t hash) const;
+
+    //Entry for a file in the library by its path, without reading it - nullptr if it is not in the index
+    const RomInfo* FindFile(const std::string& romPath) const;
+
+    const std::vector<RomInfo>& Entries() const { return entries; }
+
+    //Fill in platform and recommended instructions per frame from the ROM's contents
+    static void Profile(const uint8_t* rom, size_t size, RomInfo& info);
+
+private:
+    std::string directory;
+    std::vector<RomInfo> entries;
+    std::unordered_map<uint64_t, size_t> byHash;
+    std::unordered_map<std::string, size_t> byPath;
+
+    void Rehash();
+};
+
+//Apply info's instructions per frame and keymap to options, except where the command line already set them
+void ApplyRomProfile(const RomInfo& info, Options& options);
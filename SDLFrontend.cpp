@@ -0,0 +1,454 @@
+#include "SDLFrontend.h"
+#include "Analyzer.h"
+#include "Audio.h"
+#include "Headless.h"
+#include "InputRecording.h"
+#include "Scheduler.h"
+#include "Seek.h"
+#include "TripleBuffer.h"
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <thread>
+
+//Expands the packed display planes straight into the locked 128x64 streaming texture, one ARGB8888 pixel per hires
+//pixel (2x2 per lores pixel), coloured by the pixel's plane bits
+static void UpdateTexture(const DisplayFrame& frame, SDL_Texture* texture, const std::array<uint32_t, 4>& palette)
+{
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0)
+    {
+        std::cerr << "Failed to lock display texture: " << SDL_GetError() << '\n';
+        return;
+    }
+
+    const int scale = frame.hires ? 1 : 2;
+    for (int y = 0; y < 64; y++)
+    {
+        uint32_t* buffer = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(pixels) + y * pitch);
+        const int row = (y / scale) * 2;
+        for (int x = 0; x < 128; x++)
+        {
+            const int word = row + x / scale / 64;
+            const int bit = 63 - (x / scale) % 64;
+            buffer[x] = palette[((frame.planes[0][word] >> bit) & 1) | (((frame.planes[1][word] >> bit) & 1) << 1)];
+        }
+    }
+
+    SDL_UnlockTexture(texture);
+}
+
+//Render thread - owns the renderer and display texture, and presents the newest frame the emulation thread published
+//SDL only allows a renderer on the thread that created it, so both are created here. A slow present or vsync wait only
+//delays this thread; the emulation thread never waits on it. Sets failed if it cannot start, and counts the frames it
+//puts on screen in presented.
+static void RenderLoop(SDL_Window* window, TripleBuffer& frames, std::atomic<bool>& running, std::atomic<bool>& failed,
+                       std::atomic<uint64_t>& presented)
+{
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, 0);
+    if (renderer == NULL)
+    {
+        std::cerr << "Failed to create renderer: " << SDL_GetError() << '\n';
+        failed = true;
+        return;
+    }
+
+    //One streaming texture for the whole session - UpdateTexture writes the display into it in place every presented
+    //frame, so presenting allocates nothing
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, 128, 64);
+    if (texture == NULL)
+    {
+        std::cerr << "Failed to create display texture: " << SDL_GetError() << '\n';
+        SDL_DestroyRenderer(renderer);
+        failed = true;
+        return;
+    }
+    //Off, plane 0, plane 1 (XO-CHIP), both planes
+    const std::array<uint32_t, 4> palette = { 0xFF000000, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555 };
+
+    while (running.load(std::memory_order_relaxed))
+    {
+        if (frames.Acquire())
+        {
+            UpdateTexture(frames.Front(), texture, palette);
+            SDL_RenderCopy(renderer, texture, NULL, NULL);
+            SDL_RenderPresent(renderer);
+            presented.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            //Nothing new - a frame is published at most every 1/60s, so a short nap costs no latency worth having
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+}
+
+//SDL audio callback - pulls samples from the AudioSynth, which only ever touches the lock-free AudioQueue
+static void AudioCallback(void* userdata, Uint8* stream, int len)
+{
+    static_cast<AudioSynth*>(userdata)->Render(reinterpret_cast<int16_t*>(stream), len / static_cast<int>(sizeof(int16_t)));
+}
+
+static void HandleKeyboard(std::vector<uint8_t>& keyVector, std::vector<uint8_t>& keymap, SDL_Event &e)
+{
+    auto key = e.key.keysym.scancode;
+
+    for (int i = 0; i < 16; i++)
+    {
+        if (key == keymap[i])
+        {
+            if (e.type == SDL_KEYDOWN)
+            {
+                keyVector[i] = 1;
+            }
+            else if (e.type == SDL_KEYUP)
+            {
+                keyVector[i] = 0;
+            }
+        }
+    }
+}
+
+//Main function for running the rom - initiates the CHIP8 CPU, then runs the core game loop
+//The display and sound/delay timers are updated at 60Hz, while the CPU performs ops at the --rate/--ipf instruction rate
+//(480Hz by default, 8 instructions per frame) - the Scheduler does the pacing
+static bool Run(SDL_Window* window, const Options& options)
+{
+    std::vector<uint8_t> keymap = 
+    {
+        SDL_SCANCODE_X,
+        SDL_SCANCODE_1,
+        SDL_SCANCODE_2,
+        SDL_SCANCODE_3,
+        SDL_SCANCODE_Q,
+        SDL_SCANCODE_W,
+        SDL_SCANCODE_E,
+        SDL_SCANCODE_A,
+        SDL_SCANCODE_S,
+        SDL_SCANCODE_D,
+        SDL_SCANCODE_Z,
+        SDL_SCANCODE_C,
+        SDL_SCANCODE_4,
+        SDL_SCANCODE_R,
+        SDL_SCANCODE_F,
+        SDL_SCANCODE_V
+    };
+
+    if (options.keymap.size() == 16)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            keymap[i] = SDL_GetScancodeFromKey(std::tolower(static_cast<unsigned char>(options.keymap[i])));
+        }
+    }
+    else if (!options.keymap.empty())
+    {
+        std::cerr << "Ignoring keymap " << options.keymap << " (needs 16 keys)\n";
+    }
+
+    SDL_Event e;
+
+    CHIP8 cpu(options.core);
+    cpu.Seed(options.seed);
+    cpu.idleSkip = options.idleSkip;
+    try
+    {
+        cpu.Init(options.romPath);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return false;
+    }
+    if (!LoadStartState(cpu, options))
+    {
+        return false;
+    }
+    if (options.predecode)
+    {
+        cpu.Predecode(*AnalyzeCached(cpu.Memory()));
+    }
+
+    std::unique_ptr<TraceSession> trace;
+    if (!options.tracePath.empty())
+    {
+        trace = std::make_unique<TraceSession>(options.tracePath);
+        if (!trace->writer.IsOpen())
+        {
+            std::cerr << "Failed to open trace file " << options.tracePath << '\n';
+            return false;
+        }
+        cpu.trace = &trace->buffer;
+    }
+    std::unique_ptr<GuestProfiler> profiler = StartProfiler(cpu, options);
+    Scheduler scheduler(options.InstructionRate(), options.unthrottled);
+    bool quit = false;
+    long frame = 0;
+
+    //Sound runs on SDL's audio thread - each loop iteration sends it the audio state only when that changed, stamped
+    //with the iteration it changed on. Without an audio device the session just runs silent.
+    const int sampleRate = 48000;
+    const int audioBuffer = 512;
+    AudioQueue audioQueue;
+    AudioSynth synth(audioQueue, sampleRate, audioBuffer);
+    SDL_AudioSpec want = {};
+    want.freq = sampleRate;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = audioBuffer;
+    want.callback = AudioCallback;
+    want.userdata = &synth;
+    SDL_AudioDeviceID audioDevice = SDL_OpenAudioDevice(NULL, 0, &want, NULL, 0);
+    if (audioDevice == 0)
+    {
+        std::cerr << "No audio: " << SDL_GetError() << '\n';
+    }
+    else
+    {
+        SDL_PauseAudioDevice(audioDevice, 0);
+    }
+    AudioState sentAudio;
+    uint64_t audioFrame = 0;
+
+    //Drawn frames go to the render thread through the triple buffer - publishing copies the 2KB of display planes into
+    //the back slot (the CHIP8 keeps drawing over its own) and swaps one index
+    TripleBuffer frames;
+    std::atomic<bool> rendering{true};
+    std::atomic<bool> renderFailed{false};
+    std::atomic<uint64_t> presented{0};
+    std::thread renderThread(RenderLoop, window, std::ref(frames), std::ref(rendering), std::ref(renderFailed),
+                             std::ref(presented));
+
+    std::unique_ptr<ExecutionStats> stats = StartStats(cpu, options);
+
+    //Keypad state is recorded at the start of each frame, which is where a replay applies it
+    InputRecording recording;
+    recording.seed = options.seed;
+    recording.instructionRate = options.InstructionRate();
+    const bool recordInput = !options.recordPath.empty();
+
+    //F5 saves to quickSave (and to --save-state if given), F9 loads it back, holding Backspace steps back one frame
+    //per frame through the rewind history. Keys held right now stay held across a load or rewind.
+    //Loads and rewinds are off while recording, since a replay could not reproduce them.
+    Snapshot quickSave;
+    bool haveQuickSave = false;
+    bool rewinding = false;
+    std::unique_ptr<RewindBuffer> rewind;
+    if (options.rewindSeconds > 0 && !recordInput)
+    {
+        rewind = std::make_unique<RewindBuffer>(60, static_cast<size_t>(options.rewindSeconds) * 60);
+    }
+    Snapshot frameState;
+    auto restore = [&cpu](const Snapshot& snapshot)
+    {
+        auto keys = cpu.keyboardState;
+        cpu.LoadState(snapshot);
+        cpu.keyboardState = keys;
+        cpu.drawFlag = true;
+    };
+
+    //Time spent inside RunFrame only, so the cycles/sec report is not dominated by the frame sleep
+    std::chrono::duration<double> tEmulated(0);
+
+    auto handleEvent = [&](SDL_Event& e)
+    {
+        if (e.type == SDL_QUIT)
+        {
+            quit = true;
+        }
+
+        if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP)
+        {
+            HandleKeyboard(cpu.keyboardState, keymap, e);
+
+            auto key = e.key.keysym.scancode;
+            if (key == SDL_SCANCODE_BACKSPACE)
+            {
+                rewinding = e.type == SDL_KEYDOWN;
+            }
+            else if (e.type == SDL_KEYDOWN && !e.key.repeat && key == SDL_SCANCODE_F5)
+            {
+                cpu.SaveState(quickSave);
+                haveQuickSave = true;
+                if (!options.saveStatePath.empty())
+                {
+                    WriteSnapshotFile(options.saveStatePath, quickSave);
+                }
+            }
+            else if (e.type == SDL_KEYDOWN && !e.key.repeat && key == SDL_SCANCODE_F9 && haveQuickSave && !recordInput)
+            {
+                restore(quickSave);
+            }
+        }
+    };
+
+    //Seek straight to the target without presenting, playing sound or keeping rewind history, then show where it
+    //stopped and carry on in real time from there. A recording gets the seek's frames too, so a replay lines up.
+    if (options.seek.Active())
+    {
+        auto tStart = std::chrono::high_resolution_clock::now();
+        SeekResult seek = Seek(cpu, scheduler, options.seek, frame, options.frames, [&](long seekFrame)
+        {
+            if (recordInput)
+            {
+                recording.Record(seekFrame, cpu.keyboardState);
+            }
+        });
+        tEmulated += std::chrono::high_resolution_clock::now() - tStart;
+        frame += seek.frames;
+        std::cout << "seek: " << seek.Describe() << " after " << seek.frames << " frames\n";
+
+        DisplayFrame& back = frames.Back();
+        back.planes = cpu.planes;
+        back.hires = cpu.hires;
+        frames.Publish();
+        cpu.drawFlag = false;
+
+        quit = cpu.Halted();
+        scheduler.Resync();
+    }
+
+    //Main game loop
+    while (!quit && !renderFailed && (options.frames < 0 || frame < options.frames))
+    {      
+        auto tStart = std::chrono::high_resolution_clock::now();
+
+        if (rewinding && rewind)
+        {
+            if (rewind->StepBack(frameState))
+            {
+                restore(frameState);
+            }
+        }
+        else
+        {
+            if (recordInput)
+            {
+                recording.Record(frame, cpu.keyboardState);
+            }
+
+            scheduler.RunFrame(cpu);
+            tEmulated += std::chrono::high_resolution_clock::now() - tStart;
+            frame++;
+
+            //00FD ends the session the way closing the window does
+            if (cpu.Halted())
+            {
+                quit = true;
+            }
+
+            if (rewind)
+            {
+                cpu.SaveState(frameState);
+                rewind->Push(frameState);
+            }
+        }
+
+        //Silent while rewinding, since the sound timer is not ticking then. A full queue leaves sentAudio alone, so the
+        //change goes out next frame instead.
+        AudioState audio = CurrentAudioState(cpu);
+        audio.on = audio.on && !rewinding;
+        if (audio != sentAudio && audioQueue.Push({ audioFrame, audio }))
+        {
+            sentAudio = audio;
+        }
+        audioFrame++;
+
+        while (SDL_PollEvent(&e))
+        {
+            handleEvent(e);
+        }
+
+        if (stats && StatsDumpRequested())
+        {
+            stats->framesPresented = presented.load(std::memory_order_relaxed);
+            WriteStats(*stats, options.statsPath);
+        }
+
+        if (cpu.drawFlag)
+        {
+            DisplayFrame& back = frames.Back();
+            back.planes = cpu.planes;
+            back.hires = cpu.hires;
+            frames.Publish();
+
+            cpu.drawFlag = false;
+        }
+
+        //Stalled in Fx0A with both timers at 0 (and the buzzer already sent its stop), nothing can change until a key
+        //event arrives - block on the event queue instead of running empty frames, then restart the frame clock from
+        //when it woke up
+        if (cpu.WaitingForKey() && cpu.delayTimer == 0 && cpu.soundTimer == 0 && !cpu.SoundActive() && !rewinding)
+        {
+            if (SDL_WaitEvent(&e))
+            {
+                handleEvent(e);
+            }
+            scheduler.Resync();
+            continue;
+        }
+
+        scheduler.WaitForFrame();
+    }
+
+    //The callback uses synth and audioQueue, so the device has to stop before they go out of scope
+    if (audioDevice != 0)
+    {
+        SDL_CloseAudioDevice(audioDevice);
+    }
+    rendering = false;
+    renderThread.join();
+    trace.reset();
+    if (stats)
+    {
+        stats->framesPresented = presented;
+    }
+
+    if (renderFailed)
+    {
+        return false;
+    }
+
+    if (recordInput)
+    {
+        recording.frames = frame;
+        try
+        {
+            recording.Save(options.recordPath);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+            return false;
+        }
+    }
+
+    return ReportExit(cpu, options, tEmulated);
+}
+
+int RunSDL(const Options& options)
+{
+    //Initialize SDL window
+    SDL_Init(SDL_INIT_EVERYTHING);
+    SDL_Window* window = NULL;
+
+    //Screen dimensions for SDL window
+    const int windowWidth = 64*8;
+    const int windowHeight = 32*8;
+
+    //Creating window (Run's render thread creates the renderer and the 128 x 64 display texture)
+    window = SDL_CreateWindow("CHIP8 Interpreter", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, windowWidth, windowHeight, SDL_WINDOW_SHOWN);
+
+    bool ok = Run(window, options);
+
+    //Clean up SDL stuff on quit
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include "Options.h"
+
+//Run options.romPath in an SDL window until it is closed (or options.frames have run) - returns the process exit code
+int RunSDL(const Options& options);
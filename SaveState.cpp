@@ -0,0 +1,214 @@
+#include "SaveState.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+bool WriteSnapshotFile(const std::string& path, const Snapshot& snapshot)
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(snapshot.bytes.data()), snapshot.bytes.size());
+    if (!file)
+    {
+        std::cerr << "Failed to write save state " << path << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+bool ReadSnapshotFile(const std::string& path, Snapshot& snapshot)
+{
+    std::ifstream file(path, std::ios::binary);
+    file.read(reinterpret_cast<char*>(snapshot.bytes.data()), snapshot.bytes.size());
+    if (!file || file.peek() != std::ifstream::traits_type::eof())
+    {
+        std::cerr << "Failed to read save state " << path << " (missing, or not " << Snapshot::size << " bytes)\n";
+        return false;
+    }
+
+    return true;
+}
+
+//Deltas are the XOR of two snapshots as alternating runs: varint count of zero bytes, varint count of literal bytes,
+//then the literal bytes. Consecutive frames differ in a handful of registers and display rows, so most deltas are tens of bytes.
+static void PutVarint(std::vector<uint8_t>& out, size_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static size_t GetVarint(const uint8_t*& in)
+{
+    size_t value = 0;
+    int shift = 0;
+    while (*in & 0x80)
+    {
+        value |= static_cast<size_t>(*in++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= static_cast<size_t>(*in++) << shift;
+
+    return value;
+}
+
+static void EncodeDelta(const Snapshot& from, const Snapshot& to, std::vector<uint8_t>& out)
+{
+    out.clear();
+
+    size_t i = 0;
+    while (i < Snapshot::size)
+    {
+        //Unchanged stretches (most of RAM) are skipped eight bytes at a time
+        size_t zeros = i;
+        while (zeros + 8 <= Snapshot::size && std::memcmp(&from.bytes[zeros], &to.bytes[zeros], 8) == 0)
+        {
+            zeros += 8;
+        }
+        while (zeros < Snapshot::size && from.bytes[zeros] == to.bytes[zeros])
+        {
+            zeros++;
+        }
+
+        //A literal run ends at the first pair of unchanged bytes - a single unchanged byte is cheaper kept in the run
+        size_t literals = zeros;
+        while (literals < Snapshot::size && !(from.bytes[literals] == to.bytes[literals] &&
+               (literals + 1 == Snapshot::size || from.bytes[literals + 1] == to.bytes[literals + 1])))
+        {
+            literals++;
+        }
+
+        if (literals == zeros)
+        {
+            break;
+        }
+
+        PutVarint(out, zeros - i);
+        PutVarint(out, literals - zeros);
+        for (size_t j = zeros; j < literals; j++)
+        {
+            out.push_back(from.bytes[j] ^ to.bytes[j]);
+        }
+
+        i = literals;
+    }
+}
+
+//What keyframes are encoded against
+static const Snapshot emptySnapshot;
+
+static void ApplyDelta(const std::vector<uint8_t>& delta, Snapshot& snapshot)
+{
+    const uint8_t* in = delta.data();
+    const uint8_t* end = in + delta.size();
+
+    size_t i = 0;
+    while (in < end)
+    {
+        i += GetVarint(in);
+        size_t literals = GetVarint(in);
+        for (size_t j = 0; j < literals; j++)
+        {
+            snapshot.bytes[i++] ^= *in++;
+        }
+    }
+}
+
+RewindBuffer::RewindBuffer(int keyframeInterval, size_t capacityFrames)
+    : keyframeInterval(std::max(1, keyframeInterval)), entries(std::max<size_t>(2, capacityFrames))
+{
+}
+
+void RewindBuffer::Push(const Snapshot& snapshot)
+{
+    //Full - drop the oldest frame, then any deltas left without their keyframe so the history always starts on one
+    if (count == entries.size())
+    {
+        do
+        {
+            first = (first + 1) % entries.size();
+            count--;
+        } while (count > 0 && !At(0).keyframe);
+    }
+
+    Entry& entry = At(count);
+    if (count == 0 || sinceKeyframe + 1 >= keyframeInterval)
+    {
+        entry.keyframe = true;
+        EncodeDelta(emptySnapshot, snapshot, entry.data);
+        sinceKeyframe = 0;
+    }
+    else
+    {
+        entry.keyframe = false;
+        EncodeDelta(previous, snapshot, entry.data);
+        sinceKeyframe++;
+    }
+
+    count++;
+    previous = snapshot;
+}
+
+bool RewindBuffer::StepBack(Snapshot& snapshot)
+{
+    if (count < 2)
+    {
+        return false;
+    }
+
+    count--;
+    if (!Rebuild(count - 1, snapshot))
+    {
+        return false;
+    }
+
+    previous = snapshot;
+
+    sinceKeyframe = 0;
+    for (size_t i = count - 1; !At(i).keyframe; i--)
+    {
+        sinceKeyframe++;
+    }
+
+    return true;
+}
+
+bool RewindBuffer::Rebuild(size_t i, Snapshot& snapshot)
+{
+    size_t key = i;
+    while (!At(key).keyframe)
+    {
+        if (key == 0)
+        {
+            return false;
+        }
+        key--;
+    }
+
+    snapshot.bytes.fill(0);
+    for (size_t j = key; j <= i; j++)
+    {
+        ApplyDelta(At(j).data, snapshot);
+    }
+
+    return true;
+}
+
+size_t RewindBuffer::Frames() const
+{
+    return count > 0 ? count - 1 : 0;
+}
+
+size_t RewindBuffer::MemoryUsed() const
+{
+    size_t bytes = entries.size() * sizeof(Entry);
+    for (const auto& entry : entries)
+    {
+        bytes += entry.data.capacity();
+    }
+
+    return bytes;
+}
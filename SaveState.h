@@ -0,0 +1,68 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Full machine snapshot in a fixed-size, versioned binary layout (little-endian):
+//  magic "C8SS", uint16 version, uint16 reserved
+//  RAM[65536], registers[16], stack[16] (uint16), sp, delayTimer, soundTimer, drawFlag, pc, index,
+//  display planes[2][128] (uint64), keyboardState[16], rngState, rngSeed, cycleCount (uint64),
+//  Fx0A wait state, register and key, reserved byte, keys held (uint16),
+//  hires, plane mask, halted, pitch, flag registers[16], audio pattern[16]
+//Everything lives in one std::array, so taking or restoring a snapshot never allocates
+struct Snapshot
+{
+    static constexpr uint32_t magic = 0x53533843;
+    static constexpr uint16_t version = 3;
+    static constexpr size_t size = 8 + 0x10000 + 16 + 32 + 4 + 4 + 2 * 128 * 8 + 16 + 8 + 8 + 6 + 4 + 16 + 16;
+
+    std::array<uint8_t, size> bytes = {};
+};
+
+//Read/write a snapshot file - both return false (and print why) on failure
+bool WriteSnapshotFile(const std::string& path, const Snapshot& snapshot);
+bool ReadSnapshotFile(const std::string& path, Snapshot& snapshot);
+
+//Rewind history - a keyframe snapshot every keyframeInterval frames, and the frames between stored as
+//run-length encoded XOR deltas against the frame before (keyframes are encoded the same way against an all-zero
+//snapshot, which squeezes out the mostly unused 64KB of RAM). Going back one frame rebuilds it from the nearest
+//keyframe, which is at most keyframeInterval - 1 delta applications.
+class RewindBuffer
+{
+public:
+    RewindBuffer(int keyframeInterval, size_t capacityFrames);
+
+    //Record the state at the end of a frame
+    void Push(const Snapshot& snapshot);
+
+    //Drop the newest frame and write the one before it into snapshot - false if there is no usable history left
+    bool StepBack(Snapshot& snapshot);
+
+    //Frames that can currently be rewound, and the bytes the history is using
+    size_t Frames() const;
+    size_t MemoryUsed() const;
+
+private:
+    struct Entry
+    {
+        bool keyframe;
+        std::vector<uint8_t> data;
+    };
+
+    int keyframeInterval;
+
+    //Ring of entries - vectors keep their capacity when an entry is reused, so steady state does not allocate
+    std::vector<Entry> entries;
+    size_t first = 0;
+    size_t count = 0;
+
+    //Frames since the last keyframe, and the most recent state pushed (the base for the next delta)
+    int sinceKeyframe = 0;
+    Snapshot previous;
+
+    Entry& At(size_t i) { return entries[(first + i) % entries.size()]; }
+    bool Rebuild(size_t i, Snapshot& snapshot);
+};
@@ -0,0 +1,54 @@
+#include "Scheduler.h"
+#include <thread>
+
+Scheduler::Scheduler(int instructionsPerSecond, bool turbo) : rate(instructionsPerSecond), turbo(turbo)
+{
+    Resync();
+}
+
+void Scheduler::RunFrame(CHIP8& cpu)
+{
+    cpu.RunCycles(FrameInstructions());
+    cpu.TickTimers();
+}
+
+int Scheduler::FrameInstructions()
+{
+    remainder += rate;
+    int count = remainder / 60;
+    remainder %= 60;
+    return count;
+}
+
+void Scheduler::WaitForFrame()
+{
+    if (turbo)
+    {
+        return;
+    }
+
+    framesSinceOrigin++;
+    auto deadline = origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(Frames(framesSinceOrigin));
+    auto now = std::chrono::steady_clock::now();
+
+    if (now - deadline > Frames(maxLagFrames))
+    {
+        Resync();
+        return;
+    }
+
+    if (deadline - now > spinMargin)
+    {
+        std::this_thread::sleep_until(deadline - spinMargin);
+    }
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void Scheduler::Resync()
+{
+    origin = std::chrono::steady_clock::now();
+    framesSinceOrigin = 0;
+}
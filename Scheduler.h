@@ -0,0 +1,48 @@
+#pragma once
+#include "CHIP8.h"
+#include <chrono>
+
+//Paces a CHIP8 at a target instruction rate in 60Hz frames of emulated time
+//Each frame runs the instructions due in 1/60s at that rate (an integer accumulator carries the remainder, so 700Hz
+//alternates 11 and 12 instructions per frame and never drifts), then ticks the timers exactly once. In real time,
+//frames are released at absolute deadlines from a fixed origin - the wait sleeps until shortly before the deadline
+//and spins the rest, so frame pacing is accurate to well under a millisecond without sleep overshoot piling up.
+//Turbo runs frames back to back; the timers still tick once per emulated frame, so programs behave exactly as in real time.
+class Scheduler
+{
+public:
+    Scheduler(int instructionsPerSecond, bool turbo);
+
+    //Run one frame of emulated time on cpu
+    void RunFrame(CHIP8& cpu);
+
+    //Take the instructions due in the next frame off the accumulator, for callers that run the frame themselves
+    //(RunFrame is RunCycles of this, then one timer tick)
+    int FrameInstructions();
+
+    //Block until the next frame is due (returns immediately in turbo mode)
+    void WaitForFrame();
+
+    //Restart the deadlines from now - for after a pause, or when the host fell too far behind to catch up
+    void Resync();
+
+    //One frame, exactly 1/60s
+    using Frames = std::chrono::duration<long, std::ratio<1, 60>>;
+
+private:
+    int rate;
+    bool turbo;
+
+    //Instruction remainder carried between frames, in 1/60ths of an instruction
+    int remainder = 0;
+
+    //Deadlines are origin + framesSinceOrigin frames, converted exactly, so rounding never accumulates
+    std::chrono::steady_clock::time_point origin;
+    long framesSinceOrigin = 0;
+
+    //How far before the deadline to stop sleeping and start spinning - covers typical scheduler wakeup latency
+    static constexpr std::chrono::microseconds spinMargin{1000};
+
+    //Frames the host may lag behind before the deadlines are reset instead of being caught up in a burst
+    static constexpr long maxLagFrames = 6;
+};
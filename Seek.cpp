@@ -0,0 +1,88 @@
+#include "Seek.h"
+
+const char* SeekResult::Describe() const
+{
+    switch (stop)
+    {
+        case Stop::Frame: return "reached the target frame";
+        case Stop::PC: return "reached the target pc";
+        case Stop::Hash: return "reached the target framebuffer hash";
+        case Stop::Halted: return "halted before reaching the target";
+        case Stop::Limit: return "ran out of frames before reaching the target";
+    }
+
+    return "unknown";
+}
+
+//Run count instructions one at a time, stopping early on pc - returns true if it got there
+//RunCycles(1) rather than RunCycle keeps the profiler's sample points and the Fx0A/00FD stalls exactly as in a frame
+static bool RunUntilPC(CHIP8& cpu, int count, uint16_t pc)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const uint64_t before = cpu.cycleCount;
+        cpu.RunCycles(1);
+        if (cpu.PC() == pc)
+        {
+            return true;
+        }
+        if (cpu.cycleCount == before)
+        {
+            break;
+        }
+    }
+
+    return false;
+}
+
+SeekResult Seek(CHIP8& cpu, Scheduler& scheduler, const SeekTarget& target, long frame, long limit,
+                const std::function<void(long)>& beforeFrame)
+{
+    const long start = frame;
+    auto result = [&](SeekResult::Stop stop) { return SeekResult{ stop, frame - start }; };
+
+    if (target.hashGiven && cpu.DisplayHash() == target.hash)
+    {
+        return result(SeekResult::Stop::Hash);
+    }
+
+    while (true)
+    {
+        if (target.frame >= 0 && frame >= target.frame)
+        {
+            return result(SeekResult::Stop::Frame);
+        }
+        if (cpu.Halted())
+        {
+            return result(SeekResult::Stop::Halted);
+        }
+        if (limit >= 0 && frame - start >= limit)
+        {
+            return result(SeekResult::Stop::Limit);
+        }
+
+        if (beforeFrame)
+        {
+            beforeFrame(frame);
+        }
+
+        if (target.pc >= 0)
+        {
+            if (RunUntilPC(cpu, scheduler.FrameInstructions(), static_cast<uint16_t>(target.pc)))
+            {
+                return result(SeekResult::Stop::PC);
+            }
+            cpu.TickTimers();
+        }
+        else
+        {
+            scheduler.RunFrame(cpu);
+        }
+        frame++;
+
+        if (target.hashGiven && cpu.DisplayHash() == target.hash)
+        {
+            return result(SeekResult::Stop::Hash);
+        }
+    }
+}
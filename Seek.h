@@ -0,0 +1,46 @@
+#pragma once
+#include "CHIP8.h"
+#include "Scheduler.h"
+#include <cstdint>
+#include <functional>
+
+//Where a seek stops - as soon as any target that is set is reached
+//A frame target stops once that many frames have run from frame 0, a hash target at the end of the first frame
+//(or before the first one) the display hashes to it, and a pc target right after the instruction that lands on it,
+//part-way through its frame
+struct SeekTarget
+{
+    long frame = -1;
+    int pc = -1;
+    bool hashGiven = false;
+    uint64_t hash = 0;
+
+    bool Active() const { return frame >= 0 || pc >= 0 || hashGiven; }
+};
+
+struct SeekResult
+{
+    enum class Stop
+    {
+        Frame,
+        PC,
+        Hash,
+        Halted,
+        Limit
+    };
+
+    Stop stop;
+
+    //Whole frames run, counting the frame seeking started at
+    long frames;
+
+    bool Reached() const { return stop == Stop::Frame || stop == Stop::PC || stop == Stop::Hash; }
+    const char* Describe() const;
+};
+
+//Run cpu from frame as fast as the host allows until target is reached, 00FD halts it, or limit frames have run
+//(-1 for no limit) - frames use scheduler's instruction rate and tick the timers once each exactly as in a paced
+//run, nothing waits on the clock, and beforeFrame (if set) gets each frame number first to apply input
+//A pc target steps one instruction at a time, every other target runs whole frames through RunCycles.
+SeekResult Seek(CHIP8& cpu, Scheduler& scheduler, const SeekTarget& target, long frame, long limit,
+                const std::function<void(long)>& beforeFrame = nullptr);
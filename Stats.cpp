@@ -0,0 +1,89 @@
+#include "Stats.h"
+#include "CHIP8.h"
+#include <algorithm>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+static volatile std::sig_atomic_t dumpRequested = 0;
+
+static void OnDumpSignal(int)
+{
+    dumpRequested = 1;
+}
+
+void InstallStatsSignal()
+{
+    std::signal(SIGUSR1, OnDumpSignal);
+}
+
+bool StatsDumpRequested()
+{
+    if (!dumpRequested)
+    {
+        return false;
+    }
+
+    dumpRequested = 0;
+    return true;
+}
+
+bool WriteStats(const ExecutionStats& stats, const std::string& path, size_t hotPCs)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to write stats to " << path << '\n';
+        return false;
+    }
+
+    uint64_t instructions = 0;
+    std::vector<size_t> kinds;
+    for (size_t i = 0; i < stats.kinds.size(); i++)
+    {
+        instructions += stats.kinds[i];
+        if (stats.kinds[i] > 0)
+        {
+            kinds.push_back(i);
+        }
+    }
+    std::sort(kinds.begin(), kinds.end(), [&stats](size_t a, size_t b) { return stats.kinds[a] > stats.kinds[b]; });
+
+    //Only the busiest addresses - a full 64K histogram is rarely what anyone wants to read
+    std::vector<size_t> pcs;
+    for (size_t address = 0; address < stats.pcs.size(); address++)
+    {
+        if (stats.pcs[address] > 0)
+        {
+            pcs.push_back(address);
+        }
+    }
+    size_t shown = std::min(hotPCs, pcs.size());
+    std::partial_sort(pcs.begin(), pcs.begin() + shown, pcs.end(), [&stats](size_t a, size_t b)
+    {
+        return stats.pcs[a] > stats.pcs[b];
+    });
+
+    file << "{\n  \"instructions\": " << instructions << ",\n  \"kinds\": [\n";
+    for (size_t i = 0; i < kinds.size(); i++)
+    {
+        file << "    { \"kind\": \"" << CHIP8::KindName(static_cast<OpKind>(kinds[i])) << "\", \"count\": "
+             << stats.kinds[kinds[i]] << " }" << (i + 1 < kinds.size() ? ",\n" : "\n");
+    }
+
+    file << "  ],\n  \"distinct_pcs\": " << pcs.size() << ",\n  \"hot_pcs\": [\n";
+    for (size_t i = 0; i < shown; i++)
+    {
+        file << "    { \"pc\": \"0x" << std::hex << std::setw(4) << std::setfill('0') << pcs[i] << std::dec
+             << "\", \"count\": " << stats.pcs[pcs[i]] << " }" << (i + 1 < shown ? ",\n" : "\n");
+    }
+
+    file << "  ],\n  \"draws\": " << stats.draws << ",\n  \"rows_drawn\": " << stats.rowsDrawn
+         << ",\n  \"collisions\": " << stats.collisions
+         << ",\n  \"collision_rate\": " << (stats.draws > 0 ? static_cast<double>(stats.collisions) / stats.draws : 0.0)
+         << ",\n  \"frames_computed\": " << stats.framesComputed
+         << ",\n  \"frames_presented\": " << stats.framesPresented << "\n}\n";
+
+    return static_cast<bool>(file);
+}
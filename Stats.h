@@ -0,0 +1,38 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+
+//Compile-time switch for execution statistics - 0 compiles every counter out of the interpreter loop
+//Build with -DCHIP8_STATS=1 to use --stats
+#ifndef CHIP8_STATS
+#define CHIP8_STATS 0
+#endif
+
+//What a run spent its instructions on - filled in by a CHIP8 built with CHIP8_STATS when its stats pointer is set
+//Plain fixed arrays indexed by instruction kind and by address, so counting is one increment each
+struct ExecutionStats
+{
+    //Executions per decoded instruction kind (indexed by OpKind) and per instruction address
+    static constexpr size_t maxKinds = 64;
+    std::array<uint64_t, maxKinds> kinds = {};
+    std::array<uint64_t, 0x10000> pcs = {};
+
+    //DRW calls, sprite rows they drew and how many of them collided
+    uint64_t draws = 0;
+    uint64_t rowsDrawn = 0;
+    uint64_t collisions = 0;
+
+    //60Hz frames emulated, and frames a frontend actually put on screen
+    uint64_t framesComputed = 0;
+    uint64_t framesPresented = 0;
+};
+
+//Write stats to path as JSON: totals, every instruction kind that ran (busiest first), the hotPCs busiest addresses
+//and the draw and frame counters - returns false if the file could not be written
+bool WriteStats(const ExecutionStats& stats, const std::string& path, size_t hotPCs = 32);
+
+//SIGUSR1 asks for a stats dump while running - frontends install the handler when --stats is given and poll
+//StatsDumpRequested once a frame, which returns true (once) for each signal received
+void InstallStatsSignal();
+bool StatsDumpRequested();
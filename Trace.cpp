@@ -0,0 +1,104 @@
+#include "Trace.h"
+#include <chrono>
+#include <iomanip>
+
+TraceBuffer::TraceBuffer(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+
+    records.resize(size);
+    mask = size - 1;
+}
+
+bool TraceBuffer::Push(const TraceRecord& record)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) > mask)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    records[h & mask] = record;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+bool TraceBuffer::Pop(TraceRecord& record)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    record = records[t & mask];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+TraceWriter::TraceWriter(TraceBuffer& buffer, const std::string& path) : buffer(buffer), file(path)
+{
+    thread = std::thread([this]()
+    {
+        while (running.load(std::memory_order_relaxed))
+        {
+            Drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+}
+
+TraceWriter::~TraceWriter()
+{
+    Stop();
+}
+
+void TraceWriter::Stop()
+{
+    if (!thread.joinable())
+    {
+        return;
+    }
+
+    running = false;
+    thread.join();
+    Drain();
+
+    if (buffer.Dropped() > 0)
+    {
+        file << "# " << std::dec << buffer.Dropped() << " records dropped (trace buffer full)\n";
+    }
+    file.flush();
+}
+
+void TraceWriter::Drain()
+{
+    TraceRecord record;
+    while (buffer.Pop(record))
+    {
+        Write(record);
+    }
+}
+
+void TraceWriter::Write(const TraceRecord& record)
+{
+    file << std::dec << record.cycle << std::hex << std::setfill('0')
+         << ' ' << std::setw(3) << record.pc
+         << ' ' << std::setw(4) << record.opcode
+         << " I=" << std::setw(3) << record.index;
+
+    for (int i = 0; i < 16; i++)
+    {
+        if (record.changedRegisters & (1 << i))
+        {
+            file << " V" << std::uppercase << i << std::nouppercase << '=' << std::setw(2) << static_cast<int>(record.registers[i]);
+        }
+    }
+
+    file << std::setfill(' ') << '\n';
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Compile-time trace level - 0 compiles every trace hook out of the interpreter loop,
+//1 records control flow (jumps, calls, returns, skips), 2 records every instruction
+//Build with -DCHIP8_TRACE_LEVEL=1 or 2 to use --trace
+#ifndef CHIP8_TRACE_LEVEL
+#define CHIP8_TRACE_LEVEL 0
+#endif
+
+//One executed instruction - fixed 32 bytes so the ring is a flat array
+struct TraceRecord
+{
+    uint64_t cycle;
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t index;
+
+    //Bit i set if Vi changed, and the register values after the instruction
+    uint16_t changedRegisters;
+    std::array<uint8_t, 16> registers;
+};
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord should stay 32 bytes");
+
+//Lock-free single-producer/single-consumer ring of trace records
+//The emulation thread pushes, a TraceWriter pops. When the ring is full new records are dropped (and counted)
+//rather than making the emulation thread wait.
+class TraceBuffer
+{
+public:
+    //capacity is rounded up to a power of two
+    explicit TraceBuffer(size_t capacity = 1 << 16);
+
+    bool Push(const TraceRecord& record);
+    bool Pop(TraceRecord& record);
+
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<TraceRecord> records;
+    size_t mask;
+
+    //Kept on separate cache lines so the two threads do not bounce one line between them
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<uint64_t> dropped{0};
+};
+
+//Background thread that drains a TraceBuffer and decodes it to text:
+//<cycle> <pc> <opcode> I=<index> followed by Vn=<value> for each register the instruction changed
+class TraceWriter
+{
+public:
+    TraceWriter(TraceBuffer& buffer, const std::string& path);
+    ~TraceWriter();
+
+    bool IsOpen() const { return static_cast<bool>(file); }
+
+    //Stop the thread, then write out whatever is still in the buffer and the dropped count
+    void Stop();
+
+private:
+    TraceBuffer& buffer;
+    std::ofstream file;
+    std::atomic<bool> running{true};
+    std::thread thread;
+
+    void Drain();
+    void Write(const TraceRecord& record);
+};
+
+//Ring plus writer thread for one traced CHIP8 - what the frontends create for --trace
+//Destroying it stops the writer and flushes everything recorded so far
+struct TraceSession
+{
+    explicit TraceSession(const std::string& path) : writer(buffer, path) {}
+
+    TraceBuffer buffer;
+    TraceWriter writer;
+};
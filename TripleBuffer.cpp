@@ -0,0 +1,18 @@
+#include "TripleBuffer.h"
+
+void TripleBuffer::Publish()
+{
+    //Release makes the frame visible with the swap, acquire gets back a slot the consumer is done with
+    back = static_cast<uint8_t>(middle.exchange(back | freshBit, std::memory_order_acq_rel) & ~freshBit);
+}
+
+bool TripleBuffer::Acquire()
+{
+    if (!(middle.load(std::memory_order_relaxed) & freshBit))
+    {
+        return false;
+    }
+
+    front = static_cast<uint8_t>(middle.exchange(front, std::memory_order_acq_rel) & ~freshBit);
+    return true;
+}
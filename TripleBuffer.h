@@ -0,0 +1,39 @@
+#pragma once
+#include "CHIP8.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+//One finished display frame as the render thread needs it
+struct DisplayFrame
+{
+    std::array<CHIP8::Plane, 2> planes = {};
+    bool hires = false;
+};
+
+//Lock-free triple buffer handing display frames from the emulation thread to the render thread
+//The producer fills its back slot and publishes it by swapping it with the middle slot; the consumer swaps the middle
+//slot with its front slot whenever a newer frame is there. Both swaps are a single atomic exchange, so neither thread
+//ever waits, the producer never overwrites the frame being presented, and frames published faster than they are
+//presented are simply skipped.
+class TripleBuffer
+{
+public:
+    //Emulation thread: the slot to write the next frame into, then Publish to hand it over
+    DisplayFrame& Back() { return slots[back]; }
+    void Publish();
+
+    //Render thread: swap in the newest published frame - false if nothing was published since the last call
+    bool Acquire();
+    const DisplayFrame& Front() const { return slots[front]; }
+
+private:
+    std::array<DisplayFrame, 3> slots;
+
+    //Each index is only touched by its own thread; middle holds the third slot's index plus freshBit once it holds a
+    //frame the consumer has not taken yet
+    uint8_t back = 0;
+    uint8_t front = 1;
+    alignas(64) std::atomic<uint8_t> middle{2};
+    static constexpr uint8_t freshBit = 4;
+};
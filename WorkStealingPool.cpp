@@ -0,0 +1,73 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <thread>
+
+WorkStealingPool::WorkStealingPool(unsigned threads) : threads(std::max(1u, threads))
+{
+    for (unsigned i = 0; i < this->threads; i++)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+}
+
+void WorkStealingPool::Run(std::vector<Task> tasks)
+{
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        queues[i % threads]->tasks.push_back(std::move(tasks[i]));
+    }
+
+    //The calling thread works as worker 0
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++)
+    {
+        workers.emplace_back(&WorkStealingPool::Work, this, i);
+    }
+    Work(0);
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+bool WorkStealingPool::PopOwn(unsigned worker, Task& task)
+{
+    Queue& queue = *queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::Steal(unsigned worker, Task& task)
+{
+    for (unsigned i = 1; i < threads; i++)
+    {
+        Queue& victim = *queues[(worker + i) % threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::Work(unsigned worker)
+{
+    //No tasks are added once Run starts, so a worker with nothing to pop or steal is done
+    Task task;
+    while (PopOwn(worker, task) || Steal(worker, task))
+    {
+        task();
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//Fixed-size thread pool for a known batch of independent tasks
+//Tasks are dealt round-robin onto per-worker deques. Each worker pops from the back of its own deque and, once that
+//is empty, steals from the front of the others, so a worker that drew long jobs does not hold up the idle ones.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(unsigned threads);
+
+    //Run every task and return once all of them have finished
+    void Run(std::vector<Task> tasks);
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    unsigned threads;
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    bool PopOwn(unsigned worker, Task& task);
+    bool Steal(unsigned worker, Task& task);
+    void Work(unsigned worker);
+};
@@ -0,0 +1,250 @@
+//Benchmark runner - per-instruction microbenchmarks through RunCycle and whole-ROM macrobenchmarks through RunCycles
+//Prints one JSON document to stdout: ns/instruction and instructions/sec for every benchmark, and the peak RSS
+#include "CHIP8.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+struct BenchResult
+{
+    std::string name;
+    const char* core;
+    uint64_t instructions;
+    double seconds;
+};
+
+//Big-endian ROM bytes for a list of opcodes
+static std::vector<uint8_t> ToROM(const std::vector<uint16_t>& opcodes)
+{
+    std::vector<uint8_t> rom;
+    for (uint16_t opcode : opcodes)
+    {
+        rom.push_back(static_cast<uint8_t>(opcode >> 8));
+        rom.push_back(static_cast<uint8_t>(opcode & 0xFF));
+    }
+
+    return rom;
+}
+
+//Microbenchmark ROM - setup once, then opcode repeated up to 0xE00 and a jump back to the first repeat
+//The jump is doubled so a taken skip on the last repeat lands on a jump as well
+static std::vector<uint16_t> RepeatROM(const std::vector<uint16_t>& setup, uint16_t opcode)
+{
+    std::vector<uint16_t> rom = setup;
+    uint16_t loop = static_cast<uint16_t>(0x200 + rom.size() * 2);
+    while (0x200 + rom.size() * 2 < 0xE00)
+    {
+        rom.push_back(opcode);
+    }
+    rom.push_back(0x1000 | loop);
+    rom.push_back(0x1000 | loop);
+
+    return rom;
+}
+
+static BenchResult RunMicro(const std::string& name, const std::vector<uint8_t>& rom, Core core, uint64_t count)
+{
+    CHIP8 cpu(core);
+    cpu.Init(rom.data(), rom.size());
+
+    //Warm up caches and branch predictors before timing
+    for (uint64_t i = 0; i < count / 10; i++)
+    {
+        cpu.RunCycle();
+    }
+
+    auto tStart = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count; i++)
+    {
+        cpu.RunCycle();
+    }
+    std::chrono::duration<double> tElapsed = std::chrono::steady_clock::now() - tStart;
+
+    return { name, CHIP8::CoreName(core), count, tElapsed.count() };
+}
+
+static BenchResult RunMacro(const std::string& name, const std::vector<uint8_t>& rom, Core core, uint64_t count)
+{
+    CHIP8 cpu(core);
+    cpu.Init(rom.data(), rom.size());
+
+    //Chunks the size of a fast frame, with the timers ticking in between like RunFrame
+    const int chunk = 1000;
+    cpu.RunCycles(chunk * 10);
+
+    auto tStart = std::chrono::steady_clock::now();
+    uint64_t start = cpu.cycleCount;
+    while (cpu.cycleCount - start < count)
+    {
+        cpu.RunCycles(chunk);
+        if (cpu.delayTimer > 0) cpu.delayTimer--;
+        if (cpu.soundTimer > 0) cpu.soundTimer--;
+    }
+    std::chrono::duration<double> tElapsed = std::chrono::steady_clock::now() - tStart;
+
+    return { name, CHIP8::CoreName(core), cpu.cycleCount - start, tElapsed.count() };
+}
+
+static void PrintResults(const char* key, const std::vector<BenchResult>& results)
+{
+    std::cout << "  \"" << key << "\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        std::cout << "    { \"name\": \"" << r.name << "\", \"core\": \"" << r.core << "\", \"instructions\": " << r.instructions
+                  << ", \"ns_per_instruction\": " << r.seconds * 1e9 / r.instructions
+                  << ", \"instructions_per_sec\": " << r.instructions / r.seconds << " }"
+                  << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    std::cout << "  ],\n";
+}
+
+int main(int argc, char* args[])
+{
+    uint64_t microCycles = 5000000;
+    uint64_t macroCycles = 50000000;
+    std::string filter;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = args[i];
+        if (arg == "--micro-cycles" && i + 1 < argc)
+        {
+            microCycles = std::stoull(args[++i]);
+        }
+        else if (arg == "--macro-cycles" && i + 1 < argc)
+        {
+            macroCycles = std::stoull(args[++i]);
+        }
+        else if (arg == "--filter" && i + 1 < argc)
+        {
+            filter = args[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << args[0] << " [--micro-cycles n] [--macro-cycles n] [--filter substring]\n";
+            return 1;
+        }
+    }
+
+    //Micro: V0 = 0 and V1 = 1 throughout so skips are predictable, I at the font for DRW/Fx65 and at 0xF00 for writes
+    //(the hires setup switches to 128x64 first and points I at the big font)
+    struct Micro
+    {
+        const char* name;
+        std::vector<uint16_t> setup;
+        uint16_t opcode;
+    };
+    const std::vector<uint16_t> regs = { 0x6000, 0x6101 };
+    const std::vector<uint16_t> font = { 0x6000, 0x6101, 0xA050 };
+    const std::vector<uint16_t> scratch = { 0x6000, 0x6101, 0xAF00 };
+    const std::vector<uint16_t> hires = { 0x00FF, 0x6000, 0x6101, 0xA0A0 };
+    const std::vector<Micro> micros =
+    {
+        { "8xy0_ld", regs, 0x8010 },
+        { "8xy1_or", regs, 0x8011 },
+        { "8xy2_and", regs, 0x8012 },
+        { "8xy3_xor", regs, 0x8013 },
+        { "8xy4_add", regs, 0x8214 },
+        { "8xy5_sub", regs, 0x8215 },
+        { "8xy6_shr", regs, 0x8216 },
+        { "8xy7_subn", regs, 0x8217 },
+        { "8xyE_shl", regs, 0x821E },
+        { "Dxyn_drw_1", font, 0xD001 },
+        { "Dxyn_drw_5", font, 0xD005 },
+        { "Dxyn_drw_8", font, 0xD008 },
+        { "Dxyn_drw_15", font, 0xD00F },
+        { "Dxy0_drw_16x16", font, 0xD000 },
+        { "Dxyn_drw_8_hires", hires, 0xD008 },
+        { "Dxy0_drw_16x16_hires", hires, 0xD000 },
+        { "00C1_scroll_down", font, 0x00C1 },
+        { "00FB_scroll_right", font, 0x00FB },
+        { "00C1_scroll_down_hires", hires, 0x00C1 },
+        { "00FB_scroll_right_hires", hires, 0x00FB },
+        { "00FC_scroll_left_hires", hires, 0x00FC },
+        { "Fx33_bcd", scratch, 0xF133 },
+        { "Fx55_store", scratch, 0xF555 },
+        { "Fx65_load", font, 0xF565 },
+        { "3xnn_se_taken", regs, 0x3000 },
+        { "3xnn_se_not_taken", regs, 0x3001 },
+        { "4xnn_sne_taken", regs, 0x4001 },
+        { "4xnn_sne_not_taken", regs, 0x4000 },
+        { "5xy0_se_not_taken", regs, 0x5010 },
+        { "9xy0_sne_taken", regs, 0x9010 },
+        { "Ex9E_skp_not_taken", regs, 0xE09E },
+        { "ExA1_sknp_taken", regs, 0xE0A1 }
+    };
+
+    //Macro: small loops shaped like real programs
+    struct Macro
+    {
+        const char* name;
+        std::vector<uint16_t> rom;
+    };
+    const std::vector<Macro> macros =
+    {
+        //Register arithmetic with a counter-driven branch every 256 iterations
+        { "alu_loop", { 0x6005, 0x6103, 0x8014, 0x8125, 0x8216, 0x8307, 0x810E, 0x7401, 0x3400, 0x1204, 0x1200 } },
+        //Sprite drawing across the screen, clearing every 256 sprites
+        { "draw_loop", { 0x00E0, 0xA050, 0xD015, 0x7008, 0xD015, 0x7105, 0x7201, 0x3200, 0x1204, 0x1200 } },
+        //BCD and register dumps/loads into scratch memory
+        { "memory_loop", { 0xAF00, 0xF333, 0xF365, 0xF555, 0xF565, 0x7301, 0x1202 } },
+        //Subroutine calls with a timer read and RND in the body
+        { "call_loop", { 0x220C, 0x7001, 0xF015, 0xC1FF, 0x1200, 0x0000, 0xF107, 0x8014, 0x00EE } },
+        //The idioms the block cache fuses - sprite setup and draw, a table load, a timer poll and a loop counter
+        { "idiom_loop", { 0x6008, 0xA050, 0xD015, 0xA050, 0xD015, 0xA0A0, 0xF365, 0xF007, 0x3005, 0x7101, 0x4100, 0x1200,
+                          0x1200 } }
+    };
+
+    std::vector<BenchResult> microResults;
+    std::vector<BenchResult> macroResults;
+
+    try
+    {
+        for (const Micro& micro : micros)
+        {
+            if (std::string(micro.name).find(filter) == std::string::npos)
+            {
+                continue;
+            }
+
+            std::vector<uint8_t> rom = ToROM(RepeatROM(micro.setup, micro.opcode));
+            for (Core core : { Core::OpcodeTable, Core::Switch })
+            {
+                microResults.push_back(RunMicro(micro.name, rom, core, microCycles));
+            }
+        }
+
+        for (const Macro& macro : macros)
+        {
+            if (std::string(macro.name).find(filter) == std::string::npos)
+            {
+                continue;
+            }
+
+            std::vector<uint8_t> rom = ToROM(macro.rom);
+            for (Core core : { Core::OpcodeTable, Core::Switch, Core::BlockCache, Core::Jit })
+            {
+                macroResults.push_back(RunMacro(macro.name, rom, core, macroCycles));
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Benchmark failed: " << e.what() << '\n';
+        return 1;
+    }
+
+    //ru_maxrss is in kilobytes on Linux
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::cout << "{\n";
+    PrintResults("micro", microResults);
+    PrintResults("macro", macroResults);
+    std::cout << "  \"peak_rss_kb\": " << usage.ru_maxrss << "\n}\n";
+
+    return 0;
+}